@@ -70,6 +70,17 @@
 //  -- checked: generate firmware for ATmega8/ATmega88
 //  -- added: device scan on LCD 
 //
+//  -- added: support for more than one 1W bus, busses are scanned
+//            round-robin and conversions run in parallel
+//  -- added: read only the scratchpad bytes needed, CRC check
+//            for full scratchpad reads
+//  -- added: program TH/TL alarm limits and alarm scan via menu
+//            (serial & LCD) and remote control
+//  -- added: power safe mode - sleep until next display refresh
+//            or input, dim LCD after inactivity
+//  -- added: power_safe.cpp - idle schedule independent of hardware,
+//            host simulation in power_safe_sim.cpp
+//
 // ----------------------------------------------------------------------
 //
 
@@ -79,6 +90,7 @@
   #define USE_MENU
   #define USE_DIG_ENCODER
   #define UART_REMOTE_CONTROL
+  #define USE_POWER_SAFE
 #else
   #ifdef __AVR_ATmega168__
     // first we'll see whether tis mc makes sense ...
@@ -133,6 +145,12 @@
 #include "uart_api.h"
 #endif // UART_REMOTE_CONTROL
 
+#ifdef USE_POWER_SAFE
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include "power_safe.h"
+#endif // USE_POWER_SAFE
+
 // 
 // ------------------------ VERSION INFORMATION -------------------------
 //
@@ -141,7 +159,7 @@ static byte firmwareMinorRelease = 4;
 static byte firmwarePatchLevel   = 0;
 
 static byte protocolMajorRelease = 0;
-static byte protocolMinorRelease = 1;
+static byte protocolMinorRelease = 3;
 
 static byte hardwareMajorRelease = 1;
 static byte hardwareMinorRelease = 1;
@@ -174,6 +192,22 @@ static byte hardwareMinorRelease = 1;
 // 1W bus sensor is connected to
 #define PIN_1WIRE_BUS              13      // Pin # 1Wire Bus DS18x20 
 //
+// additional 1W bus, each bus has its own data and power pin
+#define PIN_SENSOR_POWER_2         A5      // Spannungsversorgung 2. Bus
+#define PIN_1WIRE_BUS_2            A4      // Pin # 2. 1Wire Bus
+//
+// number of 1W busses in use (1 or 2)
+#ifndef NUM_1WIRE_BUSES
+#define NUM_1WIRE_BUSES             1
+#endif // NUM_1WIRE_BUSES
+
+#if NUM_1WIRE_BUSES < 1 || NUM_1WIRE_BUSES > 2
+#error "NUM_1WIRE_BUSES must be 1 or 2"
+#endif // NUM_1WIRE_BUSES
+//
+// pseudo bus index to address all busses at once
+#define W1_BUS_ALL               0xff
+//
 // define CHIP IDs of valid DS18x2x chips
 // add more valid ids here ...
 #define CHIP_ID_DS18S20          0x10      // device is a DS18S20
@@ -183,11 +217,34 @@ static byte hardwareMinorRelease = 1;
 // tell how many tries to read from 1W bus
 #define MAX_READ_TRIES              5
 //
+// scratchpad read modes - value is number of bytes to read
+#define W1_SCRATCHPAD_SIZE          9
+#define W1_READ_TEMPERATURE         2      // bytes 0-1 temperature only
+#define W1_READ_CONFIG              5      // bytes 0-4 temp, TH, TL, config
+#define W1_READ_FULL                9      // all bytes, crc checked
+//
+// 1W bus time for one byte at standard speed (8 slots) and
+// for the reset terminating a partial scratchpad read
+#define W1_BYTE_TIME_US           560
+#define W1_RESET_TIME_US          960
+//
 // define ms to wait after power on/off bus
 #define POWER_OFF_DELAY           200
 #define POWER_ON_DELAY            200
 #define BUS_SETTLE_DELAY          100
 //
+// define ms to wait for a temperature conversion
+#define CONVERSION_DELAY         1000      // maybe 750ms is enough, maybe not
+//
+// define ms to wait for copy scratchpad to sensor EEPROM
+#define COPY_SCRATCHPAD_DELAY      15      // 10ms max. according to datasheet
+//
+// alarm limits TH/TL in degree celsius
+#define ALARM_DEFAULT_HIGH         30
+#define ALARM_DEFAULT_LOW          10
+#define ALARM_MAX_HIGH            125      // sensor range
+#define ALARM_MIN_LOW             -55
+//
 #ifdef USE_SERIAL
 // serial settings
 #define SERIAL_BAUD             38400      // serial console/debug
@@ -211,7 +268,7 @@ static byte hardwareMinorRelease = 1;
 
 #ifdef USE_EEPROM
 #define LCD_HIGHLIGHT_BRIGHTNESS    0      // brighter - active
-#define LCD_DIMMED_BRIGHTNESS       0      // dimmed - idle mode
+#define LCD_DIMMED_BRIGHTNESS     100      // dimmed - idle mode
 #else
 #define LCD_HIGHLIGHT_BRIGHTNESS    0      // brighter - active
 #define LCD_DIMMED_BRIGHTNESS       0      // dimmed - idle mode
@@ -226,8 +283,17 @@ int currentContrast;                       // current value for contrast
 int lcdType;                               // type of LCD ... to make life easier
 bool currentPowerSafeMode;                 // power safe mode = switch off Vcc of sensor 
                                            // in idle mode
-bool current1WBusPower;                    // indicates whether 1W bus is powered
+#ifdef USE_POWER_SAFE
+unsigned long powerSafeWakeups;            // number of wakeups and
+volatile unsigned long powerSafeSleepTime; // ms slept in power safe idle loop
+bool inputActivity;                        // input consumed by menus
+#endif // USE_POWER_SAFE
+unsigned long w1BytesRead;                 // scratchpad bytes read and
+unsigned long w1BytesSkipped;              // not read due to read mode
+long w1BusTimeSaved;                       // usec saved by partial reads
 bool swapDigPins;                          // swap A and B ... necessary for some DIGs
+int alarmHigh;                             // alarm limit TH
+int alarmLow;                              // alarm limit TL
 
 //
 // and these two globals we need to be flexible 
@@ -266,6 +332,7 @@ int lcdNumRows;
 #define TEXT_TESTING                   " Test ... "
 #define TEXT_DONE                      "done! "
 #define TEXT_FAIL                      "FAIL! "
+#define TEXT_NO_ALARM                  "no alarm"
 
 //
 // details for info display
@@ -284,6 +351,34 @@ int lcdNumRows;
 // 
 // create instances of 1W Bus 
 OneWire  oneWireBus(PIN_1WIRE_BUS);     // DS18x20
+#if NUM_1WIRE_BUSES > 1
+OneWire  oneWireBus2(PIN_1WIRE_BUS_2);  // DS18x20 on 2nd bus
+#endif // NUM_1WIRE_BUSES
+//
+// bus table - measurement, scan and power functions take
+// an index into this table
+struct _w1_bus_ {
+  OneWire *pBus;                        // bus instance
+  byte pinPower;                        // Vcc pin of sensors on this bus
+  bool powered;                         // indicates whether bus is powered
+};
+
+struct _w1_bus_ w1Bus[NUM_1WIRE_BUSES] = {
+  { &oneWireBus,  PIN_SENSOR_POWER,   false },
+#if NUM_1WIRE_BUSES > 1
+  { &oneWireBus2, PIN_SENSOR_POWER_2, false },
+#endif // NUM_1WIRE_BUSES
+};
+//
+// information collected from one sensor
+struct _w1_info_ {
+  byte address[8];                      // sensor id
+  byte data[12];                        // scratchpad
+  float celsius;
+  byte resolution;
+  long conversionTime;
+  bool valid;                           // true if temperature is valid
+};
 //
 // and LCD
 LiquidCrystal lcd( PIN_LCD_RS, PIN_LCD_RW, PIN_LCD_EN, 
@@ -333,6 +428,8 @@ static int encoderMenuStatus;
 #define DO_BRIGHTNESS_MENU             5
 #define DO_CONTRAST_MENU               6
 #define DO_DIG_PINSWAP_MENU            7
+#define DO_ALARM_HIGH_MENU             8
+#define DO_ALARM_LOW_MENU              9
 
 #ifdef USE_MENU
 
@@ -343,8 +440,9 @@ static int encoderMenuStatus;
 #define MENU_DIG_PINS_HEADER_TEXT      " Swap A/B pins  "
 #define MENU_BRIGHTNESS_HEADER_TEXT    "Adj. Brightness "
 #define MENU_CONTRAST_HEADER_TEXT      " Adj. Contrast  "
+#define MENU_ALARM_HEADER_TEXT         "  Alarm limits  "
 
-#define MENU_MAIN_INPUT_PROMPT         "your choice (A-H): "    // UART prompt
+#define MENU_MAIN_INPUT_PROMPT         "your choice (A-J): "    // UART prompt
 #define LCD_CHANGE_VALUE_PROMPT        "- <   click  > +"       // LCD prompt
 #define LCD_SELECT_ITEM_PROMPT         "< click=select >"       // LCD prompt
 #define MENU_019_INPUT_PROMPT          "your choice (0.1.9): "  // UART prompt
@@ -360,8 +458,10 @@ static int encoderMenuStatus;
 #define MENU_DEVICE_SCAN_SELECTION     "Device scan"          // selection F
 #define MENU_SAVE_SETTINGS_SELECTION   "Save settings"        // selection G
 #define MENU_DEFAULTS_SELECTION        "Set to defaults"      // selection H
-#define MENU_EXIT_MENU_SELECTION       "Exit menu"            // selection I
-#define MENU_NUMBER_ITEMS              9
+#define MENU_ALARM_LIMITS_SELECTION    "Alarm limits"         // selection I
+#define MENU_ALARM_SCAN_SELECTION      "Alarm scan"           // selection J
+#define MENU_EXIT_MENU_SELECTION       "Exit menu"            // LCD only
+#define MENU_NUMBER_ITEMS             11
 
 #define MENU_1WBUS_POWER_ON_SELECTION  "1W-Bus ON"
 #define MENU_1WBUS_POWER_OFF_SELECTION "1W-Bus OFF"
@@ -414,6 +514,9 @@ static int encoderMenuStatus;
 #define ITEM_MENU_DIG_NO_PINSWAP      29
 
 #define ITEM_DIG_PINS_HEADER_TEXT     30
+#define ITEM_ALARM_LIMITS             31
+#define ITEM_ALARM_SCAN               32
+#define ITEM_ALARM_HEADER_TEXT        33
 
 #define ITEM_TEXT_STORE               40
 #define ITEM_TEXT_DONE                41
@@ -440,6 +543,8 @@ static int encoderMenuStatus;
 #define LEN_ITEM_SAVE_SETTINGS        13
 #define LEN_ITEM_DEFAULTS             15
 #define LEN_ITEM_EXIT_MENU             9
+#define LEN_ITEM_ALARM_LIMITS         12
+#define LEN_ITEM_ALARM_SCAN           10
 
 #define LEN_ITEM_1WBUS_POWER_ON        9
 #define LEN_ITEM_1WBUS_POWER_OFF      10
@@ -495,9 +600,11 @@ const char menuHorDelimiter = '-';
 #define EE_POS_CONTRAST             2
 #define EE_POS_POWERSAFE            3
 #define EE_POS_SWAP_DIG_PINS        4
+#define EE_POS_ALARM_HIGH           5
+#define EE_POS_ALARM_LOW            6
 
 // change this to force reset to defaults
-#define EE_MAGIC_BYTE            0x9e
+#define EE_MAGIC_BYTE            0x9f
 
 // ---------------------------------------------------------
 // void storeSettings ( void )
@@ -517,6 +624,8 @@ void storeSettings( void )
   EEPROM.write( EE_POS_CONTRAST, currentContrast );
   EEPROM.write( EE_POS_POWERSAFE, currentPowerSafeMode );    
   EEPROM.write( EE_POS_SWAP_DIG_PINS, swapDigPins );    
+  EEPROM.write( EE_POS_ALARM_HIGH, (int8_t) alarmHigh );    
+  EEPROM.write( EE_POS_ALARM_LOW, (int8_t) alarmLow );    
 }
 
 // ---------------------------------------------------------
@@ -545,6 +654,8 @@ void restoreSettings( void )
     currentContrast = EEPROM.read( EE_POS_CONTRAST );
     currentPowerSafeMode = EEPROM.read( EE_POS_POWERSAFE );
     swapDigPins = EEPROM.read( EE_POS_SWAP_DIG_PINS );
+    alarmHigh = (int8_t) EEPROM.read( EE_POS_ALARM_HIGH );
+    alarmLow = (int8_t) EEPROM.read( EE_POS_ALARM_LOW );
   }
   else
   {
@@ -552,6 +663,8 @@ void restoreSettings( void )
     currentContrast = LCD_DEFAULT_CONTRAST;
     currentPowerSafeMode = true;
     swapDigPins = false;
+    alarmHigh = ALARM_DEFAULT_HIGH;
+    alarmLow = ALARM_DEFAULT_LOW;
     storeSettings();
   }
 }
@@ -594,6 +707,8 @@ void setup(void)
   currentBrightness = LCD_DEFAULT_BRIGHTNESS;
   currentContrast = LCD_DEFAULT_CONTRAST;
   currentPowerSafeMode = false;
+  alarmHigh = ALARM_DEFAULT_HIGH;
+  alarmLow = ALARM_DEFAULT_LOW;
 #endif // USE_EEPROM
 
 #ifdef USE_DIG_ENCODER
@@ -611,6 +726,16 @@ void setup(void)
     encoder = new ClickEncoder(PIN_ENCODER_A, PIN_ENCODER_B, PIN_ENCODER_PUSH, ENCODER_STEP);
   }
 
+#ifdef USE_POWER_SAFE
+  // dig pins wake up MCU from sleep and are latched as input
+  // activity while awake, e.g. in menus or during a test run
+  PCMSK1 |= digitalPinToBitMask(PIN_ENCODER_A) | 
+            digitalPinToBitMask(PIN_ENCODER_B) |
+            digitalPinToBitMask(PIN_ENCODER_PUSH);
+  PCIFR = _BV(PCIF1);
+  PCICR |= _BV(PCIE1);
+#endif // USE_POWER_SAFE
+
 #else
   // old fashioned PCB has no DIG onboard
   pinMode(PIN_PUSH_BUTTON,  INPUT);
@@ -620,11 +745,14 @@ void setup(void)
   pinMode(PIN_BRIGHTNESS,   OUTPUT);
   pinMode(PIN_CONTRAST,     OUTPUT);
 
-  // power pin for DS18 sensor
-  pinMode(PIN_SENSOR_POWER, OUTPUT);
+  // power pins for DS18 sensors
+  for( byte busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
+  {
+    pinMode(w1Bus[busIndex].pinPower, OUTPUT);
+  }
 
-  // first power up possible 1W device
-  powerOn1W();
+  // first power up possible 1W devices
+  powerOn1W( W1_BUS_ALL );
 
   // this is to detect LCD type
   pinMode(PIN_LCD_TYPE,     INPUT);
@@ -651,7 +779,7 @@ void setup(void)
   lcd.clear();
 
   // switch off 1W bus power
-  powerOff1W();
+  powerOff1W( W1_BUS_ALL );
 }
 //
 // --------------------------------- END GENERAL SETUP ---------------------------------
@@ -680,29 +808,122 @@ void disablePowerSafe( void )
 }
 
 // ---------------------------------------------------------
-// void powerOff1W ( void )
+// void powerSafeDelay ( unsigned long ms )
+//
+// same as delay() but let the MCU sleep between the timer 0
+// ticks if power safe mode is enabled. Like delay() it uses
+// micros(), millis() may jump forward when the watchdog
+// ISR adds the time slept.
+// ---------------------------------------------------------
+void powerSafeDelay( unsigned long ms )
+{
+#ifdef USE_POWER_SAFE
+  unsigned long start = micros();
+
+  if( currentPowerSafeMode )
+  {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    while( micros() - start < ms * 1000UL )
+    {
+      sleep_mode();
+    }
+    return;
+  }
+#endif // USE_POWER_SAFE
+
+  delay(ms);
+}
+
+// ---------------------------------------------------------
+// void powerSafeActivity ( void )
+//
+// report user input that has been consumed already, e.g.
+// by the UART menu. Keeps the MCU awake and the LCD bright
+// ---------------------------------------------------------
+void powerSafeActivity( void )
+{
+#ifdef USE_POWER_SAFE
+  inputActivity = true;
+#endif // USE_POWER_SAFE
+}
+
+// ---------------------------------------------------------
+// void powerOff1W ( byte busIndex )
 //
 // set sensor Vcc pin to LOW -> switch Vcc of sensor off
+// busIndex W1_BUS_ALL switches off all busses with a
+// single delay
 // ---------------------------------------------------------
-void powerOff1W( void )
+void powerOff1W( byte busIndex )
 {
-  digitalWrite(PIN_SENSOR_POWER, LOW);     // schaltet die Versorgungs-
-                                           // spannung des DS18x20 aus
+  for( byte i = 0; i < NUM_1WIRE_BUSES; i++ )
+  {
+    if( busIndex == W1_BUS_ALL || busIndex == i )
+    {
+      digitalWrite(w1Bus[i].pinPower, LOW);  // schaltet die Versorgungs-
+                                             // spannung des DS18x20 aus
+      w1Bus[i].powered = false;
+    }
+  }
   delay(POWER_OFF_DELAY);
-  current1WBusPower = false;
 }
 
 // ---------------------------------------------------------
-// void powerOn1W ( void )
+// void powerOn1W ( byte busIndex )
 //
 // set sensor Vc pin to HIGH -> switch Vcc of sensor on
+// busIndex W1_BUS_ALL switches on all busses with a
+// single delay
 // ---------------------------------------------------------
-void powerOn1W()
+void powerOn1W( byte busIndex )
 {
-  digitalWrite(PIN_SENSOR_POWER, HIGH);    // schaltet die Versorgungs-
-                                           // spannung des DS18x20 ein
+  for( byte i = 0; i < NUM_1WIRE_BUSES; i++ )
+  {
+    if( busIndex == W1_BUS_ALL || busIndex == i )
+    {
+      digitalWrite(w1Bus[i].pinPower, HIGH); // schaltet die Versorgungs-
+                                             // spannung des DS18x20 ein
+      w1Bus[i].powered = true;
+    }
+  }
   delay(POWER_ON_DELAY);
-  current1WBusPower = true;
+}
+
+// ---------------------------------------------------------
+// byte num1WPowered ( void )
+//
+// return number of 1W busses currently powered
+// ---------------------------------------------------------
+byte num1WPowered( void )
+{
+  byte retVal = 0;
+
+  for( byte i = 0; i < NUM_1WIRE_BUSES; i++ )
+  {
+    if( w1Bus[i].powered )
+    {
+      retVal++;
+    }
+  }
+  return( retVal );
+}
+
+// ---------------------------------------------------------
+// void require1WPower ( byte busIndex )
+//
+// power on given bus or all busses (W1_BUS_ALL) if not
+// already powered
+// ---------------------------------------------------------
+void require1WPower( byte busIndex )
+{
+  for( byte i = 0; i < NUM_1WIRE_BUSES; i++ )
+  {
+    if( (busIndex == W1_BUS_ALL || busIndex == i) && !w1Bus[i].powered )
+    {
+      powerOn1W( busIndex );
+      break;
+    }
+  }
 }
 
 // ---------------------------------------------------------
@@ -714,7 +935,8 @@ void dimLCD( void )
 {
   if( currentPowerSafeMode )
   {
-    analogWrite(PIN_BRIGHTNESS, 255-currentBrightness + LCD_DIMMED_BRIGHTNESS);
+    analogWrite(PIN_BRIGHTNESS, 
+                constrain(255-currentBrightness + LCD_DIMMED_BRIGHTNESS, 0, 255));
   }
 }
 
@@ -727,7 +949,8 @@ void highlightLCD( void )
 {
   if( currentPowerSafeMode )
   {
-    analogWrite(PIN_BRIGHTNESS, 255-currentBrightness - LCD_HIGHLIGHT_BRIGHTNESS);
+    analogWrite(PIN_BRIGHTNESS, 
+                constrain(255-currentBrightness - LCD_HIGHLIGHT_BRIGHTNESS, 0, 255));
   }
 }
 
@@ -756,129 +979,430 @@ bool isValidChipId( byte idByte )
 }
 
 // ---------------------------------------------------------
-// bool collect1WInfo( byte W1Address[8], byte data[12], 
-//                     float *celsius, byte *resolution, 
-//                     long *conversionTime )
+// bool start1WConversion( byte busIndex, byte W1Address[8] )
 //
-// read information from a speicific sensor that address is
-//      given as an argument. Return true, if sensor data
-//      have been read. In that case, celsius will contain 
-//      tepmerature in degree celsius and resolution contains
-//      the resolution the sensor is configure for.
+// search next sensor on the given bus and start a tempera-
+//      ture conversion. Return true, if conversion has been
+//      started. Does not wait for the conversion to finish,
+//      so conversions on several busses may run in parallel.
+// ---------------------------------------------------------
+bool start1WConversion( byte busIndex, byte W1Address[] )
+{
+  OneWire *pBus = w1Bus[busIndex].pBus;
+  bool retVal = false;
+
+  if ( !pBus->search(W1Address))
+  {
+    pBus->reset_search();
+  }
+  else
+  {
+    if (OneWire::crc8(W1Address, 7) != W1Address[7])
+    {
+      pBus->reset();
+    }
+    else
+    {
+      pBus->reset();
+ 
+      // the first ROM byte indicates which chip
+      if( isValidChipId( W1Address[0] ) )
+      {
+        pBus->select(W1Address);
+        // pBus->write(0x44, 1);       // start conversion, parasite power on
+        pBus->write(0x44, 0);          // start conversion, parasite power off
+        retVal = true;
+      }
+    }
+  }
+  return( retVal );
+}
+
 // ---------------------------------------------------------
-bool collect1WInfo( byte W1Address[], byte data[], float *celsius, 
-                    byte *resolution, long *conversionTime  )
+// bool read1WScratchpad( byte busIndex, byte W1Address[8], 
+//                        byte readMode, byte data[12] )
+//
+// read scratchpad of a sensor. Depending on readMode only
+//      the bytes needed are read and the transfer is termi-
+//      nated by a bus reset:
+//      W1_READ_TEMPERATURE  bytes 0-1, temperature only
+//      W1_READ_CONFIG       bytes 0-4, temperature, TH, TL
+//                           and config (0-7 for DS18S20)
+//      W1_READ_FULL         bytes 0-8, CRC is checked
+//      If the bytes skipped take less bus time than the
+//      terminating reset, the full scratchpad is read
+//      instead (e.g. DS18S20 with W1_READ_CONFIG).
+//      Return false, if no sensor answered or CRC is wrong.
+// ---------------------------------------------------------
+bool read1WScratchpad( byte busIndex, byte W1Address[], 
+                       byte readMode, byte data[] )
 {
+  OneWire *pBus = w1Bus[busIndex].pBus;
+  bool retVal = false;
+  byte numBytes = readMode;
+
+  if( readMode == W1_READ_CONFIG && W1Address[0] == CHIP_ID_DS18S20 )
+  {
+    // DS18S20 needs "count remain" and "count per C" as well
+    numBytes = W1_SCRATCHPAD_SIZE - 1;
+  }
+
+  if( (long) (W1_SCRATCHPAD_SIZE - numBytes) * W1_BYTE_TIME_US <= 
+      W1_RESET_TIME_US )
+  {
+    // partial read would not save any time, read all with crc
+    numBytes = W1_SCRATCHPAD_SIZE;
+  }
+
+  if( pBus->reset() )
+  {
+    pBus->select(W1Address);
+    pBus->write(0xBE);         // Read Scratchpad
+
+    for ( byte i = 0; i < numBytes; i++)
+    {
+      data[i] = pBus->read();
+    }
+
+    w1BytesRead += numBytes;
+
+    if( numBytes < W1_SCRATCHPAD_SIZE )
+    {
+      // stop sensor sending the remaining bytes
+      pBus->reset();
+      w1BytesSkipped += W1_SCRATCHPAD_SIZE - numBytes;
+      w1BusTimeSaved += (long) (W1_SCRATCHPAD_SIZE - numBytes) * 
+                        W1_BYTE_TIME_US - W1_RESET_TIME_US;
+      retVal = true;
+    }
+    else
+    {
+      retVal = (OneWire::crc8(data, 8) == data[8]);
+    }
+  }
+
+  return( retVal );
+}
 
+// ---------------------------------------------------------
+// bool read1WInfo( byte busIndex, byte W1Address[8], 
+//                  byte readMode, byte data[12], 
+//                  float *celsius, byte *resolution, 
+//                  long *conversionTime )
+//
+// read scratchpad of a sensor a conversion has been started
+//      for by start1WConversion(). Return true, if
+//      temperature is valid. For W1_READ_TEMPERATURE
+//      resolution and conversion time are unknown and
+//      set to 0.
+// ---------------------------------------------------------
+bool read1WInfo( byte busIndex, byte W1Address[], byte readMode,
+                 byte data[], float *celsius, byte *resolution, 
+                 long *conversionTime  )
+{
   bool validTemp = false;
   float calcTemp;
   int16_t raw;
-  int runs;
 
-  for( runs = 0; !validTemp && runs < MAX_READ_TRIES; runs++ )
+  if( !read1WScratchpad( busIndex, W1Address, readMode, data ) )
+  {
+    return( validTemp );
+  }
+  
+  // Convert the data to actual temperature
+  // because the result is a 16 bit signed integer, it should
+  // be stored to an "int16_t" type, which is always 16 bits
+  // even when compiled on a 32 bit processor.
+  
+  raw = (data[1] << 8) | data[0];
+  if( W1Address[0] == CHIP_ID_DS18S20 )
   {
-    if ( !oneWireBus.search(W1Address))
+    raw = raw << 3; // 9 bit resolution default
+    *resolution = 9;
+    *conversionTime = 93750;
+    if (readMode != W1_READ_TEMPERATURE && data[7] == 0x10)
     {
-      oneWireBus.reset_search();
+      // "count remain" gives full 12 bit resolution
+      raw = (raw & 0xFFF0) + 12 - data[6];
+      *resolution = 12;
+      *conversionTime = 750000;
+    }
+  }
+  else
+  {
+    if( readMode == W1_READ_TEMPERATURE )
+    {
+      // config not read, resolution is unknown
+      *resolution = 0;
+      *conversionTime = 0;
     }
     else
     {
-      if (OneWire::crc8(W1Address, 7) != W1Address[7])
+      // at lower res, the low bits are undefined, so let's zero them
+      byte cfg = (data[4] & 0x60);
+      switch( cfg )
+      {
+        case 0x00:
+          raw = raw & ~7;  // 9 bit resolution, 93.75 ms
+          *resolution = 9;
+          *conversionTime = 93750;
+          break;
+        case 0x20:
+          raw = raw & ~3; // 10 bit res, 187.5 ms
+          *resolution = 10;
+          *conversionTime = 187500;
+        case 0x40:
+          raw = raw & ~1; // 11 bit res, 375 ms
+          *resolution = 11;
+          *conversionTime = 375000;
+          break;
+        default:
+          // default is 12 bit resolution, 750 ms conversion time
+          *resolution = 12;
+          *conversionTime = 750000;
+        break;
+      }
+    }
+  }
+        
+  if( (calcTemp = (float)raw / 16.0) != 127.0 && calcTemp != 85.0 )
+  {
+    validTemp = true;
+    *celsius = calcTemp;
+  }
+
+  return( validTemp );
+}
+
+// ---------------------------------------------------------
+// void collectAll1WInfo( struct _w1_info_ w1Info[], 
+//                        byte readMode )
+//
+// read information from the sensor which address is given
+//      in w1Info[] for each bus. Conversions on all busses
+//      are started first, so there is one conversion delay
+//      per try regardless of the number of busses.
+// ---------------------------------------------------------
+void collectAll1WInfo( struct _w1_info_ w1Info[], byte readMode )
+{
+  bool started[NUM_1WIRE_BUSES];
+  bool pending = true;
+  bool converting;
+  byte busIndex;
+  int runs;
+
+  for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
+  {
+    memset( &w1Info[busIndex], '\0', sizeof(struct _w1_info_) );
+  }
+
+  for( runs = 0; pending && runs < MAX_READ_TRIES; runs++ )
+  {
+    pending = false;
+    converting = false;
+
+    for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
+    {
+      started[busIndex] = false;
+      if( !w1Info[busIndex].valid )
+      {
+        pending = true;
+        if( start1WConversion( busIndex, w1Info[busIndex].address ) )
+        {
+          started[busIndex] = converting = true;
+        }
+      }
+    }
+
+    if( converting )
+    {
+      powerSafeDelay(CONVERSION_DELAY);
+
+      for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
+      {
+        if( started[busIndex] )
+        {
+          w1Info[busIndex].valid = read1WInfo( busIndex, 
+                                       w1Info[busIndex].address,
+                                       readMode,
+                                       w1Info[busIndex].data,
+                                       &w1Info[busIndex].celsius,
+                                       &w1Info[busIndex].resolution,
+                                       &w1Info[busIndex].conversionTime );
+        }
+      }
+    }
+  }
+}
+
+// ---------------------------------------------------------
+// bool write1WAlarm( byte busIndex, byte W1Address[8], 
+//                    int th, int tl )
+//
+// write alarm limits to scratchpad of a sensor and copy
+//      them to the sensor's EEPROM. Configuration of a
+//      DS18B20/DS1822 is kept. The scratchpad is read with
+//      CRC check before and after writing, it is copied to
+//      EEPROM only if TH/TL read back match.
+//      Return true on success.
+// ---------------------------------------------------------
+bool write1WAlarm( byte busIndex, byte W1Address[], int th, int tl )
+{
+  OneWire *pBus = w1Bus[busIndex].pBus;
+  byte data[W1_SCRATCHPAD_SIZE];
+  bool retVal = false;
+
+  if( isValidChipId( W1Address[0] ) &&
+      read1WScratchpad( busIndex, W1Address, W1_READ_FULL, data ) )
+  {
+    pBus->reset();
+    pBus->select(W1Address);
+    pBus->write(0x4E);              // Write Scratchpad
+    pBus->write((int8_t) th);
+    pBus->write((int8_t) tl);
+    if( W1Address[0] != CHIP_ID_DS18S20 )
+    {
+      pBus->write(data[4]);         // keep resolution
+    }
+
+    // verify before the sensor's EEPROM is written
+    if( read1WScratchpad( busIndex, W1Address, W1_READ_FULL, data ) &&
+        data[2] == (byte) th && data[3] == (byte) tl )
+    {
+      pBus->reset();
+      pBus->select(W1Address);
+      pBus->write(0x48);            // Copy Scratchpad
+      delay(COPY_SCRATCHPAD_DELAY);
+      pBus->reset();
+
+      retVal = true;
+    }
+  }
+
+  return( retVal );
+}
+
+// ---------------------------------------------------------
+// byte set1WAlarm( byte busIndex, byte sensorID[], 
+//                  int th, int tl )
+//
+// program alarm limits of sensor with given id or of all
+//      sensors if sensorID is NULL. busIndex W1_BUS_ALL
+//      addresses all busses. Return number of sensors
+//      programmed.
+// ---------------------------------------------------------
+byte set1WAlarm( byte busIndex, byte sensorID[], int th, int tl )
+{
+  byte W1Address[8];
+  byte retVal = 0;
+
+  for( byte i = 0; i < NUM_1WIRE_BUSES; i++ )
+  {
+    if( busIndex == W1_BUS_ALL || busIndex == i )
+    {
+      if( sensorID != NULL )
       {
-        oneWireBus.reset();
+        if( write1WAlarm( i, sensorID, th, tl ) )
+        {
+          retVal++;
+        }
       }
       else
       {
-        oneWireBus.reset();
- 
-        // the first ROM byte indicates which chip
-        if( isValidChipId( W1Address[0] ) )
+        w1Bus[i].pBus->reset_search();
+        while( w1Bus[i].pBus->search(W1Address) )
         {
-          oneWireBus.select(W1Address);
-          // oneWireBus.write(0x44, 1);     // start conversion, parasite power on
-          oneWireBus.write(0x44, 0);        // start conversion, parasite power off
-      
-          delay(1000);     // maybe 750ms is enough, maybe not
-  
-          oneWireBus.reset();
-          oneWireBus.select(W1Address);
-          oneWireBus.write(0xBE);         // Read Scratchpad
-  
-          // we need 9 bytes
-          for ( int i = 0; i < 9; i++)
-          {
-            data[i] = oneWireBus.read();
-          }
-  
-          // Convert the data to actual temperature
-          // because the result is a 16 bit signed integer, it should
-          // be stored to an "int16_t" type, which is always 16 bits
-          // even when compiled on a 32 bit processor.
-  
-          raw = (data[1] << 8) | data[0];
-          if( W1Address[0] == CHIP_ID_DS18S20 )
-          {
-            raw = raw << 3; // 9 bit resolution default
-            *resolution = 9;
-            *conversionTime = 93750;
-            if (data[7] == 0x10)
-            {
-              // "count remain" gives full 12 bit resolution
-              raw = (raw & 0xFFF0) + 12 - data[6];
-              *resolution = 12;
-              *conversionTime = 750000;
-            }
-          }
-          else
-          {
-            // at lower res, the low bits are undefined, so let's zero them
-            byte cfg = (data[4] & 0x60);
-            switch( cfg )
-            {
-              case 0x00:
-                raw = raw & ~7;  // 9 bit resolution, 93.75 ms
-                *resolution = 9;
-                *conversionTime = 93750;
-                break;
-              case 0x20:
-                raw = raw & ~3; // 10 bit res, 187.5 ms
-                *resolution = 10;
-                *conversionTime = 187500;
-              case 0x40:
-                raw = raw & ~1; // 11 bit res, 375 ms
-                *resolution = 11;
-                *conversionTime = 375000;
-                break;
-              default:
-                // default is 12 bit resolution, 750 ms conversion time
-                *resolution = 12;
-                *conversionTime = 750000;
-              break;
-            }
-          }
-        
-          if( (calcTemp = (float)raw / 16.0) != 127.0 && calcTemp != 85.0 )
+          if( OneWire::crc8(W1Address, 7) == W1Address[7] &&
+              write1WAlarm( i, W1Address, th, tl ) )
           {
-            validTemp = true;
-            *celsius = calcTemp;
+            retVal++;
           }
         }
       }
     }
   }
-  return( validTemp );
+
+  return( retVal );
+}
+
+// ---------------------------------------------------------
+// void convertAll1W( byte busIndex )
+//
+// start a conversion on all sensors of the given bus(ses)
+//      at once (skip ROM) and wait for it to finish. 
+//      Afterwards the alarm flag of each sensor is valid.
+// ---------------------------------------------------------
+void convertAll1W( byte busIndex )
+{
+  bool converting = false;
+
+  for( byte i = 0; i < NUM_1WIRE_BUSES; i++ )
+  {
+    if( busIndex == W1_BUS_ALL || busIndex == i )
+    {
+      if( w1Bus[i].pBus->reset() )
+      {
+        w1Bus[i].pBus->skip();
+        w1Bus[i].pBus->write(0x44, 0);   // start conversion, parasite power off
+        converting = true;
+      }
+    }
+  }
+
+  if( converting )
+  {
+    powerSafeDelay(CONVERSION_DELAY);
+  }
+}
+
+// ---------------------------------------------------------
+// byte getAlarmID( byte busIndex, bool first, byte sensorID[] )
+//
+// locate first or next sensor on the given bus that has
+//      its alarm flag set (Alarm Search 0xEC). Only sensors
+//      out of their TH/TL window answer.
+// ---------------------------------------------------------
+byte getAlarmID( byte busIndex, bool first, byte sensorID[] )
+{
+  OneWire *pBus;
+
+  if( busIndex >= NUM_1WIRE_BUSES )
+  {
+    return( 0 );
+  }
+
+  pBus = w1Bus[busIndex].pBus;
+
+  if( first )
+  {
+    pBus->reset_search();
+  }
+
+  while( pBus->search(sensorID, false) )
+  {
+    if( OneWire::crc8(sensorID, 7) == sensorID[7] )
+    {
+      return( 1 );
+    }
+  }
+
+  pBus->reset_search();
+  return( 0 );
 }
 
 // ---------------------------------------------------------
 // void reset2Defaults( void )
 //
-// reset brightness, contrast and powesafe to their defaults
+// reset brightness, contrast, powesafe and alarm limits to
+// their defaults
 // ---------------------------------------------------------
 void reset2Defaults( void )
 {
   currentBrightness = LCD_DEFAULT_BRIGHTNESS;
   currentContrast = LCD_DEFAULT_CONTRAST;
   currentPowerSafeMode = true;
+  alarmHigh = ALARM_DEFAULT_HIGH;
+  alarmLow = ALARM_DEFAULT_LOW;
 #ifdef USE_EEPROM
   storeSettings();
 #endif // USE_EEPROM
@@ -922,19 +1446,22 @@ String ScrollTxt(String txt)
 }
 
 // ---------------------------------------------------------
-// void idleDisplay( bool reset )
+// unsigned long idleDisplay( bool reset )
 // 
 // display idle information
 // first line of LCD toggles two different textes
 // second line is a scrolled information
+// return ms until next refresh is due
 // ---------------------------------------------------------
-void idleDisplay( bool reset )
+unsigned long idleDisplay( bool reset )
 {
   static String newScrollText = String(F(SCROLL_TEXT_PART_1)) + String(F(SCROLL_TEXT_PART_2));
   static unsigned long lastToggleRefresh;
   static unsigned long lastScrollRefresh;
   static byte toggle;
   static bool staticTextDone = false;
+  unsigned long nextRefresh;
+  unsigned long elapsed;
 
   if( reset )
   {
@@ -1019,9 +1546,30 @@ void idleDisplay( bool reset )
       }
   }
 
-}
+  nextRefresh = 0;
+  elapsed = millis() - lastToggleRefresh;
+  if( elapsed < LCD_REFRESH_TOGGLE_LINE )
+  {
+    nextRefresh = LCD_REFRESH_TOGGLE_LINE - elapsed;
+  }
 
-// ---------------------------------------------------------
+  if( lcdType == LCD_TYPE_1602 )
+  {
+    elapsed = millis() - lastScrollRefresh;
+    if( elapsed >= LCD_REFRESH_SCROLL_LINE )
+    {
+      nextRefresh = 0;
+    }
+    else if( LCD_REFRESH_SCROLL_LINE - elapsed < nextRefresh )
+    {
+      nextRefresh = LCD_REFRESH_SCROLL_LINE - elapsed;
+    }
+  }
+
+  return( nextRefresh );
+}
+
+// ---------------------------------------------------------
 // void infoDisplay( byte addr[], float temp, 
 //                   byte resolution, long conversionTime )
 //
@@ -1116,21 +1664,21 @@ void infoDisplay( byte addr[], float temp, byte resolution,
 // void doTestRun( void )
 //
 // perform a test run if sensor is found
+// one sensor per bus is tested, results are displayed one
+// after another
 // ---------------------------------------------------------
 void doTestRun( void )
 {
-  static byte W1Address[8];
-  static byte data[12];
-  float celsius;
-  byte resolution;
-  long conversionTime;
+  static struct _w1_info_ w1Info[NUM_1WIRE_BUSES];
+  byte busIndex;
 
-  memset( W1Address, '\0', sizeof(W1Address) );
-  powerOn1W();
+  powerOn1W( W1_BUS_ALL );
 
-  if( collect1WInfo(W1Address, data, &celsius, &resolution, &conversionTime) )
+  collectAll1WInfo( w1Info, W1_READ_CONFIG );
+
+  for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
   {
-    if( isValidChipId( W1Address[0] ) )
+    if( w1Info[busIndex].valid && isValidChipId( w1Info[busIndex].address[0] ) )
     {    
       lcd.clear();
       if( lcdType == LCD_TYPE_2004 )
@@ -1138,12 +1686,13 @@ void doTestRun( void )
         lcd.print(F(TEXT_TESTING));
       }
 
-      infoDisplay(W1Address, celsius, resolution, conversionTime);
-      delay(INFO_DISPLAY_TIME);
+      infoDisplay(w1Info[busIndex].address, w1Info[busIndex].celsius, 
+                  w1Info[busIndex].resolution, w1Info[busIndex].conversionTime);
+      powerSafeDelay(INFO_DISPLAY_TIME);
     }
   }
 
-  powerOff1W();
+  powerOff1W( W1_BUS_ALL );
   
 }
 
@@ -1188,29 +1737,35 @@ void printAddr( byte addr[] )
 
 
 // ---------------------------------------------------------
-// byte getSensorID( bool first, byte sensorID[] )
+// byte getSensorID( byte busIndex, bool first, byte sensorID[] )
 //
-// get next sensor id on bus, perform a power on
-// if first flag is set
+// get next sensor id on given bus, perform a power on
+// and restart search if first flag is set
 // ---------------------------------------------------------
-byte getSensorID( bool first, byte sensorID[] )
+byte getSensorID( byte busIndex, bool first, byte sensorID[] )
 {
 
   byte retVal = 0;
 
+  if( busIndex >= NUM_1WIRE_BUSES )
+  {
+    return( retVal );
+  }
+
   if( first )
   {
-    powerOn1W();
+    powerOn1W( busIndex );
+    w1Bus[busIndex].pBus->reset_search();
   }
 
-  if(oneWireBus.search(sensorID))
+  if(w1Bus[busIndex].pBus->search(sensorID))
   {
     retVal = 1;
   }
   else
   {
-    oneWireBus.reset_search();
-    powerOff1W();
+    w1Bus[busIndex].pBus->reset_search();
+    powerOff1W( busIndex );
     retVal = 0;
   }
 
@@ -1225,46 +1780,106 @@ byte getSensorID( bool first, byte sensorID[] )
 // ---------------------------------------------------------
 void doScan( void )
 {
-  static byte W1Address[8];
-  static byte data[12];
-  float celsius;
-  byte resolution;
-  long conversionTime;
-
-  memset( W1Address, '\0', sizeof(W1Address) );
+  static struct _w1_info_ w1Info[NUM_1WIRE_BUSES];
+  bool found = false;
+  byte busIndex;
 
   if( lcdType == LCD_TYPE_2004 )
   {
     lcd.print(F(TEXT_SCANNING));
   }
 
-  powerOn1W();
+  powerOn1W( W1_BUS_ALL );
+
+  collectAll1WInfo( w1Info, W1_READ_TEMPERATURE );
+
+  for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
+  {
+    if( w1Info[busIndex].valid )
+    {
+      if( !found && lcdType == LCD_TYPE_2004 )
+      {
+        lcd.print(F(TEXT_DONE));
+      }
+      found = true;
+
+      if( isValidChipId( w1Info[busIndex].address[0] ) )
+      {    
+        printAddr(w1Info[busIndex].address);
+        powerSafeDelay(INFO_DISPLAY_TIME);
+      }
+    }
+  }
 
-  if( collect1WInfo(W1Address, data, &celsius, &resolution, &conversionTime) )
+  if( !found )
   {
     if( lcdType == LCD_TYPE_2004 )
     {
-      lcd.print(F(TEXT_DONE));
+      lcd.print(F(TEXT_FAIL));
     }
+    powerSafeDelay(INFO_DISPLAY_TIME);
+  }
 
-    if( isValidChipId( W1Address[0] ) )
-    {    
+  powerOff1W( W1_BUS_ALL );
 
-      printAddr(W1Address);
-    }
+  lcd.clear();
+  
+}
+
+// ---------------------------------------------------------
+// void doAlarmScan( void )
+//
+// start conversion on all sensors at once and display the
+// sensors that are out of their TH/TL window only
+// ---------------------------------------------------------
+void doAlarmScan( void )
+{
+  byte W1Address[8];
+  byte numAlarms = 0;
+  byte busIndex;
 
+  if( lcdType == LCD_TYPE_2004 )
+  {
+    lcd.print(F(TEXT_SCANNING));
   }
-  else
+
+  powerOn1W( W1_BUS_ALL );
+
+  convertAll1W( W1_BUS_ALL );
+
+  if( lcdType == LCD_TYPE_2004 )
   {
-    if( lcdType == LCD_TYPE_2004 )
+    lcd.print(F(TEXT_DONE));
+  }
+
+  for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
+  {
+    bool first = true;
+
+    while( getAlarmID( busIndex, first, W1Address ) )
     {
-      lcd.print(F(TEXT_FAIL));
+      first = false;
+      numAlarms++;
+      printAddr(W1Address);
+      powerSafeDelay(INFO_DISPLAY_TIME);
     }
   }
 
-  delay(INFO_DISPLAY_TIME);
+  if( numAlarms == 0 )
+  {
+    if( lcdType == LCD_TYPE_1602 )
+    {
+      lcd.setCursor(0, LCD_16x2_LINE_SENDOR_ID);
+    }
+    else
+    {
+      lcd.setCursor(2, LCD_20x4_LINE_SENDOR_ID);
+    }
+    lcd.print(F(TEXT_NO_ALARM));
+    powerSafeDelay(INFO_DISPLAY_TIME);
+  }
 
-  powerOff1W();
+  powerOff1W( W1_BUS_ALL );
 
   lcd.clear();
   
@@ -1327,6 +1942,10 @@ void displayItem( byte device, byte which, char *pPrefix,
       pItem = F(MENU_CONTRAST_HEADER_TEXT);    
       displayLength = 16;
       break;
+    case ITEM_ALARM_HEADER_TEXT:
+      pItem = F(MENU_ALARM_HEADER_TEXT);    
+      displayLength = 16;
+      break;
     case ITEM_MAIN_INPUT_PROMPT:
       pItem = F(MENU_MAIN_INPUT_PROMPT);
       displayLength = 0;
@@ -1393,6 +2012,14 @@ void displayItem( byte device, byte which, char *pPrefix,
       pItem = F(MENU_DEFAULTS_SELECTION);
       displayLength = LEN_ITEM_DEFAULTS;
       break;
+    case ITEM_ALARM_LIMITS:
+      pItem = F(MENU_ALARM_LIMITS_SELECTION);
+      displayLength = LEN_ITEM_ALARM_LIMITS;
+      break;
+    case ITEM_ALARM_SCAN:
+      pItem = F(MENU_ALARM_SCAN_SELECTION);
+      displayLength = LEN_ITEM_ALARM_SCAN;
+      break;
     case ITEM_EXIT_MENU:
       pItem = F(MENU_EXIT_MENU_SELECTION);
       displayLength = LEN_ITEM_EXIT_MENU;
@@ -1430,6 +2057,10 @@ void displayItem( byte device, byte which, char *pPrefix,
       pItem = F(TEXT_DONE);
       displayLength = LEN_ITEM_TEXT_DONE;
       break;
+    case ITEM_TEXT_FAIL:
+      pItem = F(TEXT_FAIL);
+      displayLength = LEN_ITEM_TEXT_FAIL;
+      break;
     case ITEM_TEXT_RESET:
       pItem = F(TEXT_RESET);
       displayLength = LEN_ITEM_TEXT_RESET;
@@ -1605,6 +2236,7 @@ void displayItem( byte device, byte which, char *pPrefix,
 	    }
 	    break;
 	  case ITEM_TEXT_DONE:
+	  case ITEM_TEXT_FAIL:
 	    Serial.print( pItem );
 	    if( lineFeed )
 	    {
@@ -1743,6 +2375,10 @@ void displayUartMenu( void )
                    "G - ", true,  TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
   displayItem( OUTPUT_DEVICE_UART, ITEM_DEFAULTS,
                    "H - ", true,  TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
+  displayItem( OUTPUT_DEVICE_UART, ITEM_ALARM_LIMITS,
+                   "I - ", true,  TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
+  displayItem( OUTPUT_DEVICE_UART, ITEM_ALARM_SCAN,
+                   "J - ", true,  TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
 
   displayItem( OUTPUT_DEVICE_UART, ITEM_HORIZONTAL_RULER,
                    "", true,  TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
@@ -1818,6 +2454,12 @@ void uartSubMenuSwapDigPins( void )
 void uartSubMenuPowerSafe( void )
 {
 #ifdef __AVR_ATmega328P__
+#ifdef USE_POWER_SAFE
+  unsigned long sleepTime;
+  unsigned long wakeups;
+  unsigned long upTime;
+#endif // USE_POWER_SAFE
+
   displayItem( OUTPUT_DEVICE_UART, ITEM_NEW_LINE,
                    "", true, TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
   displayItem( OUTPUT_DEVICE_UART, ITEM_POWERSAFE_HEADER_TEXT,
@@ -1825,6 +2467,30 @@ void uartSubMenuPowerSafe( void )
   displayItem( OUTPUT_DEVICE_UART, ITEM_HORIZONTAL_RULER,
                    "", true,  TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
 
+#ifdef USE_POWER_SAFE
+  // snapshot, sleep time is updated by watchdog ISR
+  cli();
+  sleepTime = powerSafeSleepTime;
+  sei();
+  wakeups = powerSafeWakeups;
+  upTime = millis();
+
+  Serial.print( F("Slept ") );
+  Serial.print( sleepTime / 1000 );
+  Serial.print( F(" of ") );
+  Serial.print( upTime / 1000 );
+  Serial.print( F(" sec., ") );
+  Serial.print( wakeups );
+  Serial.print( F(" wakeups") );
+  if( upTime >= 60000 )
+  {
+    Serial.print( F(" (") );
+    Serial.print( wakeups / (upTime / 60000) );
+    Serial.print( F(" per minute up time)") );
+  }
+  Serial.println( "." );
+#endif // USE_POWER_SAFE
+
   displayItem( OUTPUT_DEVICE_UART, ITEM_POWERSAFE_OFF,
                    "0 - ", true, TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
   displayItem( OUTPUT_DEVICE_UART, ITEM_POWERSAFE_ON,
@@ -1978,126 +2644,372 @@ void uartFlush( void )
   }
 }
 
+// ---------------------------------------------------------
+// void uartPrintDevice( byte busIndex, byte addr[] )
+//
+// send bus index and sensor id to serial connection
+// ---------------------------------------------------------
+void uartPrintDevice( byte busIndex, byte addr[] )
+{
+  Serial.println();
+  Serial.print("Device ");
+
+  // display address
+  // e.g. 10-00080278c4d6  
+  //      28-00000629aa92
+  Serial.print( addr[0], HEX);
+  Serial.print("-");
+  for ( int i = 6; i > 0; i--)
+  {
+    if( addr[i] < 0x10 )
+    {
+      Serial.print("0");
+    }
+    Serial.print( addr[i], HEX);
+  }
+
+#if NUM_1WIRE_BUSES > 1
+  Serial.print(" on bus ");
+  Serial.print(busIndex);
+#else
+  (void) busIndex;                      // single bus, not shown
+#endif // NUM_1WIRE_BUSES
+}
+
+// ---------------------------------------------------------
+// void uartPrintBusTime( void )
+//
+// send number of scratchpad bytes read and bus time saved
+// by reading only the bytes needed (less the terminating
+// bus resets) to serial connection
+// ---------------------------------------------------------
+void uartPrintBusTime( void )
+{
+  Serial.print( F("Scratchpad bytes read: ") );
+  Serial.print( w1BytesRead );
+  Serial.print( F(", skipped: ") );
+  Serial.print( w1BytesSkipped );
+  Serial.print( F(" (") );
+  Serial.print( w1BusTimeSaved );
+  Serial.println( F(" usec bus time saved).") );
+}
+
 // ---------------------------------------------------------
 // void uartScan1W( void )
 //
-// scan 1Wire bus for devices
-// if one found display information to serial connection
+// scan 1Wire busses for devices
+// busses are searched round-robin, one device per bus and
+// round. Information of the first device of each bus is
+// sent to serial connection
 // ---------------------------------------------------------
 void uartScan1W( void )
 {
-  static byte W1Address[8];
-  static byte data[12];
-  float celsius;
-  byte resolution;
-  long conversionTime;
+  static struct _w1_info_ w1Info[NUM_1WIRE_BUSES];
+  bool searching[NUM_1WIRE_BUSES];
+  bool found = false;
+  bool active;
+  byte busIndex;
 
-  memset( W1Address, '\0', sizeof(W1Address) );
-
-  powerOn1W();
+  powerOn1W( W1_BUS_ALL );
  
   Serial.println( "Scan 1W bus ..." );
 
+  for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
+  {
+    w1Bus[busIndex].pBus->reset_search();
+    searching[busIndex] = true;
+  }
 
-
-  while ( oneWireBus.search(W1Address))
+  do
   {
+    active = false;
 
+    for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
+    {
+      if( searching[busIndex] )
+      {
+        if( w1Bus[busIndex].pBus->search(w1Info[busIndex].address) )
+        {
+          active = true;
+          uartPrintDevice( busIndex, w1Info[busIndex].address );
+        }
+        else
+        {
+          searching[busIndex] = false;
+        }
+      }
+    }
+  } while( active );
 
-    Serial.println();
-    Serial.print("Device ");
+  collectAll1WInfo( w1Info, W1_READ_FULL );
 
-    // display address
-    // e.g. 10-00080278c4d6  
-    //      28-00000629aa92
-    Serial.print( W1Address[0], HEX);
-    Serial.print("-");
-    for ( int i = 6; i > 0; i--)
+  for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
+  {
+    if( w1Info[busIndex].address[0] != '\0' )
     {
-      if( W1Address[i] < 0x10 )
+      found = true;
+      uartPrintDevice( busIndex, w1Info[busIndex].address );
+
+      Serial.print(" is ");
+
+      switch (w1Info[busIndex].address[0])
       {
-        Serial.print("0");
+        case CHIP_ID_DS18S20:
+          Serial.print("a DS18S20");
+          break;
+        case CHIP_ID_DS18B20:
+          Serial.print("a DS18B20");
+          break;
+        case CHIP_ID_DS1822:
+          Serial.print("a DS1822");
+          break;
+        default:
+          Serial.print("NOT a DS18x2x");
+          break;
       }
-      Serial.print( W1Address[i], HEX);
+
+      Serial.println();
+
+      if( isValidChipId( w1Info[busIndex].address[0] ) )
+      {
+        Serial.print("Resolution is ");
+        Serial.print(w1Info[busIndex].resolution);
+        Serial.print(" bit, conversion time ");
+        Serial.print(w1Info[busIndex].conversionTime);
+
+        Serial.println(" usec.");
+        Serial.print("Temp is ");
+        Serial.print(w1Info[busIndex].celsius);
+        Serial.print("°C (");
+        Serial.print(w1Info[busIndex].celsius * 1.8 + 32.0);
+        Serial.println("°F).");
+
+        Serial.print("data dump: ");
+        for( int i = 0; i < 12; i++ )
+        {
+          Serial.print(w1Info[busIndex].data[i]);
+          Serial.print(" ");
+        }
+      }
+      Serial.println();      
     }
+  }
 
+  if( !found )
+  {
+    Serial.println("NO 1W device found ...");
   }
 
+  uartPrintBusTime();
 
+  powerOff1W( W1_BUS_ALL );
+  menuStatus = DO_MAIN_MENU;
+  uartFlush();  
+}
 
+// ---------------------------------------------------------
+// void uartAlarmScan1W( void )
+//
+// start conversion on all sensors at once, then search the
+// 1Wire busses round-robin for sensors with alarm flag set
+// and send their ids to serial connection
+// ---------------------------------------------------------
+void uartAlarmScan1W( void )
+{
+  byte W1Address[8];
+  bool searching[NUM_1WIRE_BUSES];
+  bool first = true;
+  bool active;
+  byte busIndex;
+  int numAlarms = 0;
+
+  powerOn1W( W1_BUS_ALL );
  
-  collect1WInfo(W1Address, data, &celsius, &resolution, &conversionTime);
+  Serial.print( F("Alarm scan 1W bus, TH ") );
+  Serial.print( alarmHigh );
+  Serial.print( F(", TL ") );
+  Serial.print( alarmLow );
+  Serial.println( F(" ...") );
+
+  convertAll1W( W1_BUS_ALL );
 
-  if( W1Address[0] != '\0' )
+  for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
   {
-    Serial.println();
-    Serial.print("Device ");
+    searching[busIndex] = true;
+  }
 
-    // display address
-    // e.g. 10-00080278c4d6  
-    //      28-00000629aa92
-    Serial.print( W1Address[0], HEX);
-    Serial.print("-");
-    for ( int i = 6; i > 0; i--)
+  do
+  {
+    active = false;
+
+    for( busIndex = 0; busIndex < NUM_1WIRE_BUSES; busIndex++ )
     {
-      if( W1Address[i] < 0x10 )
+      if( searching[busIndex] )
       {
-        Serial.print("0");
+        if( getAlarmID( busIndex, first, W1Address ) )
+        {
+          active = true;
+          numAlarms++;
+          uartPrintDevice( busIndex, W1Address );
+        }
+        else
+        {
+          searching[busIndex] = false;
+        }
       }
-      Serial.print( W1Address[i], HEX);
     }
+    first = false;
+  } while( active );
 
-    Serial.print(" is ");
+  Serial.println();
+  Serial.print( numAlarms );
+  Serial.println( F(" device(s) out of range.") );
 
-    switch (W1Address[0])
-    {
-      case CHIP_ID_DS18S20:
-        Serial.print("a DS18S20");
-        break;
-      case CHIP_ID_DS18B20:
-        Serial.print("a DS18B20");
-        break;
-      case CHIP_ID_DS1822:
-        Serial.print("a DS1822");
-        break;
-      default:
-        Serial.print("NOT a DS18x2x");
-        break;
-    }
+  powerOff1W( W1_BUS_ALL );
+  menuStatus = DO_MAIN_MENU;
+  uartFlush();  
+}
 
+// ---------------------------------------------------------
+// void uartSubMenuAlarmLimit( bool high )
+//
+// display prompt for alarm limit TH (high) or TL to serial
+// connection
+// ---------------------------------------------------------
+void uartSubMenuAlarmLimit( bool high )
+{
+#ifdef __AVR_ATmega328P__
+  if( high )
+  {
+    displayItem( OUTPUT_DEVICE_UART, ITEM_NEW_LINE,
+                     "", true, TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
+    displayItem( OUTPUT_DEVICE_UART, ITEM_ALARM_HEADER_TEXT,
+                     "", true,  TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
+    displayItem( OUTPUT_DEVICE_UART, ITEM_HORIZONTAL_RULER,
+                     "", true,  TEXT_ALIGN_NONE, MAX_MENU_WIDTH );
+    Serial.print( F("TH") );
+    Serial.print( F(CURRENT_VALUE_TEXT) );
+    Serial.print( alarmHigh );
+  }
+  else
+  {
     Serial.println();
+    Serial.print( F("TL") );
+    Serial.print( F(CURRENT_VALUE_TEXT) );
+    Serial.print( alarmLow );
+  }
 
-    if( isValidChipId( W1Address[0] ) )
-    {
-      Serial.print("Resolution is ");
-      Serial.print(resolution);
-      Serial.print(" bit, conversion time ");
-      Serial.print(conversionTime);
+  Serial.println( "." );
+  Serial.print( F("Enter new value (-55-125,x): ") );
+#endif // __AVR_ATmega328P__
+}
+
+// ---------------------------------------------------------
+// void uartSetAlarmLimits( void )
+//
+// program alarm limits into all sensors and send some
+// informational text to serial connection
+// ---------------------------------------------------------
+void uartSetAlarmLimits( void )
+{
+  byte numSensors;
 
-      Serial.println(" usec.");
-      Serial.print("Temp is ");
-      Serial.print(celsius);
-      Serial.print("°C (");
-      Serial.print(celsius * 1.8 + 32.0);
-      Serial.println("°F).");
+  Serial.println();
+  powerOn1W( W1_BUS_ALL );
+  numSensors = set1WAlarm( W1_BUS_ALL, NULL, alarmHigh, alarmLow );
+  powerOff1W( W1_BUS_ALL );
 
-      Serial.print("data dump: ");
-      for( int i = 0; i < 12; i++ )
-      {
-        Serial.print(data[i]);
-        Serial.print(" ");
-      }
+  Serial.print( F("Alarm limits TH ") );
+  Serial.print( alarmHigh );
+  Serial.print( F(", TL ") );
+  Serial.print( alarmLow );
+  Serial.print( F(" set for ") );
+  Serial.print( numSensors );
+  Serial.println( F(" device(s).") );
+
+  menuStatus = DO_MAIN_MENU;
+  uartFlush();  
+}
+
+// ---------------------------------------------------------
+// bool uartSignedInput( int *pValue, bool *pValid )
+//
+// collect a signed decimal value from serial connection
+// return true if input is complete (CR, LF or x). pValid
+// is false if input is empty, has been cancelled by x, has
+// a '-' after the first digit or is out of the range
+// ALARM_MIN_LOW .. ALARM_MAX_HIGH.
+// ---------------------------------------------------------
+bool uartSignedInput( int *pValue, bool *pValid )
+{
+  static int numericInput;
+  static int inputLength;
+  static bool negative;
+  static bool invalid;
+  bool inputComplete = false;
+
+  while( !inputComplete && Serial.available() )
+  {
+    byte choice = Serial.read();
+    switch( choice )
+    {
+        case '-':
+          if( inputLength == 0 )
+          {
+            negative = true;
+          }
+          else
+          {
+            invalid = true;
+          }
+          break;
+        case '0':            
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+          inputLength++;
+          if( !invalid )
+          {
+            // value stays within limits, no overflow possible
+            numericInput = numericInput * 10 + ( choice - '0' );
+            if( (negative && -numericInput < ALARM_MIN_LOW) ||
+                (!negative && numericInput > ALARM_MAX_HIGH) )
+            {
+              invalid = true;
+            }
+          }
+          break;
+        case 0x0d:
+        case 0x0a:
+          inputComplete = true;
+          *pValid = (inputLength > 0 && !invalid);
+          break;
+        case 'x':
+        case 'X':
+          inputComplete = true;
+          *pValid = false;
+          break;
+        default:
+          break;
     }
-    Serial.println();      
   }
-  else
+
+  if( inputComplete )
   {
-    Serial.println("NO 1W device found ...");
+    *pValue = negative ? -numericInput : numericInput;
+    numericInput = 0;
+    inputLength = 0;
+    negative = false;
+    invalid = false;
   }
 
-  powerOff1W();
-  menuStatus = DO_MAIN_MENU;
-  uartFlush();  
+  return( inputComplete );
 }
 
 // ---------------------------------------------------------
@@ -2117,9 +3029,9 @@ void uartPowerOff1W( void )
   
   Serial.print( F("1W bus is ") );
 
-  if( current1WBusPower )
+  if( num1WPowered() > 0 )
   {
-    powerOff1W();
+    powerOff1W( W1_BUS_ALL );
     Serial.print( F("now "));
   }
   else
@@ -2201,9 +3113,9 @@ void uartPowerOn1W( void )
   Serial.println( F("Power on 1W bus") );
   Serial.print( F("1W bus is "));
 
-  if( !current1WBusPower )
+  if( num1WPowered() < NUM_1WIRE_BUSES )
   {
-    powerOn1W();
+    powerOn1W( W1_BUS_ALL );
     Serial.print( F("now "));
   }
   else
@@ -2428,58 +3340,280 @@ void uartControlRun( bool reset )
 
   }
 
-  if( lastReadSuccess != 0 )
+  if( lastReadSuccess != 0 )
+  {
+    if( millis() - lastReadSuccess >= UART_CTL_TIMEOUT*10 )
+    {
+      cmdBufferIndex = 0;
+      telegramIndex = 0;
+      lastReadSuccess = 0;
+      cmdCompleted = false;
+      _uartErrorCode = UART_CTL_E_TIMEOUT;
+      menuStatus = DO_MAIN_MENU;
+      uartFlush();  
+      clearTelegram( &command );
+      clearTelegram( &response );
+      memset( controlBuf, '\0', sizeof(controlBuf) );
+    }
+  }
+}
+
+// ---------------------------------------------------------
+// byte getNextSensorID( byte busIndex, byte sensorID[]  )
+//
+// locate next device on bus
+// ---------------------------------------------------------
+byte getNextSensorID( byte busIndex, byte sensorID[]  )
+{
+  return( getSensorID( busIndex, false, sensorID ) );
+}
+
+// ---------------------------------------------------------
+// byte getFirstSensorID( byte busIndex, byte sensorID[] )
+//
+// locate first device on 1W bus
+// ---------------------------------------------------------
+byte getFirstSensorID( byte busIndex, byte sensorID[] )
+{
+
+  return( getSensorID( busIndex, true, sensorID ) );
+}
+
+// ---------------------------------------------------------
+// byte getSensorScratchpad( byte busIndex, byte sensorID[],
+//                           byte readMode, byte data[] )
+//
+// start conversion on sensor with given id and read the
+// scratchpad bytes needed for readMode. A converting sensor
+// holds the bus low in read slots - if the first slot reads
+// 1, no sensor with this id is on the bus. This replaces
+// the CRC check missing for partial reads.
+// ---------------------------------------------------------
+byte getSensorScratchpad( byte busIndex, byte sensorID[],
+                          byte readMode, byte data[] )
+{
+  byte retVal = 0;
+  OneWire *pBus;
+
+  if( busIndex >= NUM_1WIRE_BUSES )
+  {
+    return( retVal );
+  }
+
+  require1WPower( busIndex );
+
+  pBus = w1Bus[busIndex].pBus;
+
+  if( pBus->reset() )
+  {
+    pBus->select(sensorID);
+    pBus->write(0x44, 0);          // start conversion, parasite power off
+
+    if( pBus->read_bit() != 0 )
+    {
+      // sensor not on this bus or not converting
+      return( retVal );
+    }
+
+    powerSafeDelay(CONVERSION_DELAY);
+
+    if( read1WScratchpad( busIndex, sensorID, readMode, data ) )
+    {
+      retVal = 1;
+    }
+  }
+
+  return( retVal );
+}
+
+// ---------------------------------------------------------
+// byte getFirstSensorTemp( byte busIndex, byte sensorID[],
+//                          byte data[] )
+//
+// locate first device on 1W bus and read its temperature
+// bytes only
+// ---------------------------------------------------------
+byte getFirstSensorTemp( byte busIndex, byte sensorID[], byte data[] )
+{
+  byte retVal = 0;
+
+  if( getFirstSensorID( busIndex, sensorID ) )
+  {
+    retVal = getSensorScratchpad( busIndex, sensorID, 
+                                  W1_READ_TEMPERATURE, data );
+  }
+  return( retVal );
+}
+
+// ---------------------------------------------------------
+// byte getNextSensorTemp( byte busIndex, byte sensorID[],
+//                         byte data[] )
+//
+// locate next device on 1W bus and read its temperature
+// bytes only
+// ---------------------------------------------------------
+byte getNextSensorTemp( byte busIndex, byte sensorID[], byte data[] )
+{
+  byte retVal = 0;
+
+  if( getNextSensorID( busIndex, sensorID ) )
+  {
+    retVal = getSensorScratchpad( busIndex, sensorID, 
+                                  W1_READ_TEMPERATURE, data );
+  }
+  return( retVal );
+}
+
+// ---------------------------------------------------------
+// byte getSensorTemp( byte busIndex, byte sensorID[],
+//                     byte data[] )
+//
+// read temperature bytes only of sensor with given id
+// ---------------------------------------------------------
+byte getSensorTemp( byte busIndex, byte sensorID[], byte data[] )
+{
+  return( getSensorScratchpad( busIndex, sensorID, 
+                               W1_READ_TEMPERATURE, data ) );
+}
+
+// ---------------------------------------------------------
+// byte getFirstSensorData( byte busIndex, byte sensorID[],
+//                          byte data[] )
+//
+// locate first device on 1W bus and read its complete
+// scratchpad, crc checked
+// ---------------------------------------------------------
+byte getFirstSensorData( byte busIndex, byte sensorID[], byte data[] )
+{
+  byte retVal = 0;
+
+  if( getFirstSensorID( busIndex, sensorID ) )
+  {
+    retVal = getSensorScratchpad( busIndex, sensorID, 
+                                  W1_READ_FULL, data );
+  }
+  return( retVal );
+}
+
+// ---------------------------------------------------------
+// byte getNextSensorData( byte busIndex, byte sensorID[],
+//                         byte data[] )
+//
+// locate next device on 1W bus and read its complete
+// scratchpad, crc checked
+// ---------------------------------------------------------
+byte getNextSensorData( byte busIndex, byte sensorID[], byte data[] )
+{
+  byte retVal = 0;
+
+  if( getNextSensorID( busIndex, sensorID ) )
+  {
+    retVal = getSensorScratchpad( busIndex, sensorID, 
+                                  W1_READ_FULL, data );
+  }
+  return( retVal );
+}
+
+// ---------------------------------------------------------
+// byte getSensorData( byte busIndex, byte sensorID[],
+//                     byte data[] )
+//
+// read complete scratchpad of sensor with given id, 
+// crc checked
+// ---------------------------------------------------------
+byte getSensorData( byte busIndex, byte sensorID[], byte data[] )
+{
+  return( getSensorScratchpad( busIndex, sensorID, 
+                               W1_READ_FULL, data ) );
+}
+
+// ---------------------------------------------------------
+// byte setSensorPower( byte busIndex, bool powerOn )
+//
+// switch Vcc of one or all (W1_BUS_ALL) 1W busses on or off
+// return 0 if bus index is out of range
+// ---------------------------------------------------------
+byte setSensorPower( byte busIndex, bool powerOn )
+{
+  if( busIndex != W1_BUS_ALL && busIndex >= NUM_1WIRE_BUSES )
+  {
+    return( 0 );
+  }
+
+  if( powerOn )
   {
-    if( millis() - lastReadSuccess >= UART_CTL_TIMEOUT*10 )
-    {
-      cmdBufferIndex = 0;
-      telegramIndex = 0;
-      lastReadSuccess = 0;
-      cmdCompleted = false;
-      _uartErrorCode = UART_CTL_E_TIMEOUT;
-      menuStatus = DO_MAIN_MENU;
-      uartFlush();  
-      clearTelegram( &command );
-      clearTelegram( &response );
-      memset( controlBuf, '\0', sizeof(controlBuf) );
-    }
+    powerOn1W( busIndex );
+  }
+  else
+  {
+    powerOff1W( busIndex );
   }
+
+  return( 1 );
 }
 
 // ---------------------------------------------------------
-// byte getNextSensorID( byte sensorID[]  )
+// byte setSensorAlarm( byte busIndex, byte sensorID[],
+//                      int th, int tl )
 //
-// locate next device on bus
+// program alarm limits of sensor with given id or of all
+// sensors (sensorID NULL) on one or all (W1_BUS_ALL) busses
+// return number of sensors programmed
 // ---------------------------------------------------------
-byte getNextSensorID( byte sensorID[]  )
+byte setSensorAlarm( byte busIndex, byte sensorID[], int th, int tl )
 {
-  return( getSensorID( false, sensorID ) );
+  if( busIndex != W1_BUS_ALL && busIndex >= NUM_1WIRE_BUSES )
+  {
+    return( 0 );
+  }
+
+  if( th < tl || th > ALARM_MAX_HIGH || tl < ALARM_MIN_LOW )
+  {
+    return( 0 );
+  }
+
+  require1WPower( busIndex );
+
+  return( set1WAlarm( busIndex, sensorID, th, tl ) );
 }
 
 // ---------------------------------------------------------
-// byte getFirstSensorID( byte sensorID[] )
+// byte startAlarmConversion( byte busIndex )
 //
-// locate first device on 1W bus
+// start conversion on all sensors of one or all busses and
+// wait for it, afterwards alarm search may be performed
 // ---------------------------------------------------------
-byte getFirstSensorID( byte sensorID[] )
+byte startAlarmConversion( byte busIndex )
 {
+  if( busIndex != W1_BUS_ALL && busIndex >= NUM_1WIRE_BUSES )
+  {
+    return( 0 );
+  }
 
-  return( getSensorID( true, sensorID ) );
-}
+  require1WPower( busIndex );
+  convertAll1W( busIndex );
 
-byte getFirstSensorTemp( byte sensorID[] )
-{
-return( 0 );
+  return( 1 );
 }
 
-byte getNextSensorTemp( byte sensorID[] )
+// ---------------------------------------------------------
+// byte getFirstAlarmID( byte busIndex, byte sensorID[] )
+//
+// locate first device with alarm flag set on 1W bus
+// ---------------------------------------------------------
+byte getFirstAlarmID( byte busIndex, byte sensorID[] )
 {
-return( 0 );
+  return( getAlarmID( busIndex, true, sensorID ) );
 }
 
-byte getSensorTemp( byte sensorID[] )
+// ---------------------------------------------------------
+// byte getNextAlarmID( byte busIndex, byte sensorID[] )
+//
+// locate next device with alarm flag set on 1W bus
+// ---------------------------------------------------------
+byte getNextAlarmID( byte busIndex, byte sensorID[] )
 {
-return( 0 );
+  return( getAlarmID( busIndex, false, sensorID ) );
 }
 
 
@@ -2505,6 +3639,13 @@ void uartMenu( void )
   static int numericInput;
   static int inputLength;
   static bool inputComplete;
+  static int newAlarmHigh;
+
+  if( Serial.available() )
+  {
+    // input is consumed below, tell power safe mode first
+    powerSafeActivity();
+  }
 
   switch( menuStatus )
   {
@@ -2580,6 +3721,18 @@ void uartMenu( void )
             uartReset2Defaults();
             menuStatus = DO_1WBUS_MENU;
             break;
+          // #define MENU_ALARM_LIMITS_SELECTION   "Alarm limits"         // selection I
+          case 'i':
+          case 'I':
+            uartSubMenuAlarmLimit( true );
+            menuStatus = DO_ALARM_HIGH_MENU;
+            uartFlush();
+            break;
+          // #define MENU_ALARM_SCAN_SELECTION     "Alarm scan"           // selection J
+          case 'j':
+          case 'J':
+            uartAlarmScan1W();
+            break;
 #ifdef UART_REMOTE_CONTROL
           case '%':
             menuStatus = DO_UART_CONTROL;
@@ -2760,6 +3913,44 @@ void uartMenu( void )
         }
       }
       break;
+    case DO_ALARM_HIGH_MENU:
+      if( uartSignedInput( &numericInput, &inputComplete ) )
+      {
+        if( inputComplete && numericInput >= ALARM_MIN_LOW && 
+            numericInput <= ALARM_MAX_HIGH )
+        {
+          newAlarmHigh = numericInput;
+          uartSubMenuAlarmLimit( false );
+          menuStatus = DO_ALARM_LOW_MENU;
+        }
+        else
+        {
+          menuStatus = DO_MAIN_MENU;
+        }
+        uartFlush();
+        inputComplete = false;
+        numericInput = 0;
+      }
+      break;
+    case DO_ALARM_LOW_MENU:
+      if( uartSignedInput( &numericInput, &inputComplete ) )
+      {
+        if( inputComplete && numericInput >= ALARM_MIN_LOW && 
+            numericInput <= newAlarmHigh )
+        {
+          alarmHigh = newAlarmHigh;
+          alarmLow = numericInput;
+          uartSetAlarmLimits();
+        }
+        else
+        {
+          menuStatus = DO_MAIN_MENU;
+        }
+        uartFlush();
+        inputComplete = false;
+        numericInput = 0;
+      }
+      break;
 #ifdef UART_REMOTE_CONTROL
     case DO_UART_CONTROL:
       uartControlRun(false);
@@ -3188,7 +4379,7 @@ void encoderPower1WBus( void )
   // lcd.setCursor(COLUMN, LINE);
   lcd.setCursor(0, 1);
 
-  if( current1WBusPower )
+  if( num1WPowered() > 0 )
   {
     displayItem( OUTPUT_DEVICE_LCD, ITEM_1WBUS_POWER_OFF,
                      "", false, TEXT_ALIGN_CENTER, lcdNumColumns );
@@ -3277,10 +4468,10 @@ void encoderPower1WBus( void )
           switch( currItem )
           {
             case 0:                             // ITEM_1WBUS_POWER_OFF
-              powerOff1W();
+              powerOff1W( W1_BUS_ALL );
               break;
             case 1:                             // ITEM_1WBUS_POWER_ON
-              powerOn1W();
+              powerOn1W( W1_BUS_ALL );
               break;
             case 2:                             // ITEM_TEXT_CANCEL_ACTION
               power1WBusChangeExit = true;
@@ -3444,6 +4635,142 @@ void encoderPowerSafe( void )
 
 
 
+#ifdef USE_DIG_ENCODER
+//
+// -------------------------------- DIG ALARM LIMITS -----------------------------------
+//
+void encoderShowAlarmLimits( int currItem, int th, int tl )
+{
+  int limit[2] = { th, tl };
+
+  // lcd.setCursor(COLUMN, LINE);
+  lcd.setCursor(0, 1);
+
+  for( int i = 0; i < 2; i++ )
+  {
+    lcd.print( currItem == i ? ">" : " " );
+    lcd.print( i == 0 ? F("TH") : F("TL") );
+
+    if( limit[i] > -10 && limit[i] < 100 )
+    {
+      lcd.print(" ");
+    }
+
+    if( limit[i] >= 0 && limit[i] < 10 )
+    {
+      lcd.print(" ");
+    }
+
+    lcd.print( limit[i] );
+    lcd.print("  ");
+  }
+}
+
+void encoderAlarmLimits( void )
+{
+  static int16_t last, value;
+  bool alarmLimitsExit = false;
+  int currItem = 0;                   // 0 = TH, 1 = TL
+  int th = alarmHigh;                 // edited limits, taken over
+  int tl = alarmLow;                  // on final click only
+  byte numSensors;                    // sensors programmed
+
+  lcd.clear();
+  // lcd.setCursor(COLUMN, LINE);
+  lcd.setCursor(0, 0);
+
+  displayItem( OUTPUT_DEVICE_LCD, ITEM_ALARM_HEADER_TEXT,
+                   "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
+
+  encoderShowAlarmLimits( currItem, th, tl );
+
+  value = encoder->getValue();
+  last = value;
+
+  while( !alarmLimitsExit )
+  {
+    encoder->service(); 
+
+    value += encoder->getValue();
+
+    if (value != last) 
+    {
+      if( currItem == 0 )
+      {
+        if( value > last && th < ALARM_MAX_HIGH )
+        {
+          th++;
+        }
+        if( value < last && th > tl )
+        {
+          th--;
+        }
+      }
+      else
+      {
+        if( value > last && tl < th )
+        {
+          tl++;
+        }
+        if( value < last && tl > ALARM_MIN_LOW )
+        {
+          tl--;
+        }
+      }
+
+      last = value;
+      encoderShowAlarmLimits( currItem, th, tl );
+    }
+
+    ClickEncoder::Button b = encoder->getButton();
+    if (b != ClickEncoder::Open) 
+    {
+      switch (b) 
+      {
+        case ClickEncoder::Clicked:
+          if( currItem == 0 )
+          {
+            currItem = 1;
+            encoderShowAlarmLimits( currItem, th, tl );
+          }
+          else
+          {
+            // program limits into all sensors
+            alarmHigh = th;
+            alarmLow  = tl;
+            lcd.setCursor(0, 1);
+            displayItem( OUTPUT_DEVICE_LCD, ITEM_TEXT_STORE,
+                             "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
+            powerOn1W( W1_BUS_ALL );
+            numSensors = set1WAlarm( W1_BUS_ALL, NULL, alarmHigh, alarmLow );
+            powerOff1W( W1_BUS_ALL );
+
+            lcd.setCursor(0, 1);
+            displayItem( OUTPUT_DEVICE_LCD, 
+                             numSensors > 0 ? ITEM_TEXT_DONE : ITEM_TEXT_FAIL,
+                             "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
+            delay(1000);
+            alarmLimitsExit = true;
+          }
+          break;
+        case ClickEncoder::DoubleClicked:
+          alarmLimitsExit = true;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+  lcd.clear();
+}
+//
+// ------------------------------ END DIG ALARM LIMITS ---------------------------------
+//
+#endif // USE_DIG_ENCODER
+
+
+
+
 #ifdef USE_DIG_ENCODER
 //
 // ----------------------------------- DIG MENU LOOP -----------------------------------
@@ -3558,14 +4885,22 @@ void encoderMenu( void )
                            "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
           break;
         case 6:
-          displayItem( OUTPUT_DEVICE_LCD, ITEM_SAVE_SETTINGS,
+          displayItem( OUTPUT_DEVICE_LCD, ITEM_ALARM_LIMITS,
                            "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
           break;
         case 7:
-          displayItem( OUTPUT_DEVICE_LCD, ITEM_DEFAULTS,
+          displayItem( OUTPUT_DEVICE_LCD, ITEM_ALARM_SCAN,
                            "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
           break;
         case 8:
+          displayItem( OUTPUT_DEVICE_LCD, ITEM_SAVE_SETTINGS,
+                           "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
+          break;
+        case 9:
+          displayItem( OUTPUT_DEVICE_LCD, ITEM_DEFAULTS,
+                           "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
+          break;
+        case 10:
           displayItem( OUTPUT_DEVICE_LCD, ITEM_EXIT_MENU,
                            "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
           break;
@@ -3689,7 +5024,41 @@ void encoderMenu( void )
                                "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
               entryCall = true;
               break;
-            case 6:                // ITEM_SAVE_SETTINGS
+            case 6:                // ITEM_ALARM_LIMITS
+              encoderAlarmLimits();
+              if( lcdType == LCD_TYPE_1602 )
+              {
+                lcd.setCursor(0, LCD_16x2_LINE_SELECT_ITEM);
+              }
+              else
+              {
+                lcd.setCursor(0, 0);
+                displayItem( OUTPUT_DEVICE_LCD, ITEM_MAIN_HEADER_TEXT,
+                             "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
+                lcd.setCursor(0, LCD_20x4_LINE_SELECT_ITEM);
+              }
+              displayItem( OUTPUT_DEVICE_LCD, ITEM_LCD_SELECT_ITEM_PROMPT,
+                               "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
+              entryCall = true;
+              break;
+            case 7:                // ITEM_ALARM_SCAN
+              doAlarmScan();
+              if( lcdType == LCD_TYPE_1602 )
+              {
+                lcd.setCursor(0, LCD_16x2_LINE_SELECT_ITEM);
+              }
+              else
+              {
+                lcd.setCursor(0, 0);
+                displayItem( OUTPUT_DEVICE_LCD, ITEM_MAIN_HEADER_TEXT,
+                             "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
+                lcd.setCursor(0, LCD_20x4_LINE_SELECT_ITEM);
+              }
+              displayItem( OUTPUT_DEVICE_LCD, ITEM_LCD_SELECT_ITEM_PROMPT,
+                               "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
+              entryCall = true;
+              break;
+            case 8:                // ITEM_SAVE_SETTINGS
               encoderSaveSettings();
               if( lcdType == LCD_TYPE_1602 )
               {
@@ -3706,7 +5075,7 @@ void encoderMenu( void )
                                "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
               entryCall = true;
               break;
-            case 7:                // ITEM_DEFAULTS
+            case 9:                // ITEM_DEFAULTS
               encoderSetToDefault();
               if( lcdType == LCD_TYPE_1602 )
               {
@@ -3723,7 +5092,7 @@ void encoderMenu( void )
                                "", false,  TEXT_ALIGN_CENTER, lcdNumColumns );
               entryCall = true;
               break;
-            case 8:                // ITEM_EXIT_MENU
+            case 10:               // ITEM_EXIT_MENU
               menuExit = true;
               break;
             default:
@@ -3803,6 +5172,189 @@ void encoderCheck (void )
 //
 #endif // USE_DIG_ENCODER
 
+#ifdef USE_POWER_SAFE
+//
+// ------------------------------------ POWER SAFE -------------------------------------
+//
+// In power safe mode the MCU sleeps (idle mode) in the main loop until
+// the next display refresh is due or until the dig or the UART wakes
+// it up. The millis() tick is stopped while sleeping, the watchdog
+// timer wakes up the MCU and the time slept is added to millis().
+// If an input wakes the MCU earlier, the watchdog period is left
+// running and the MCU stays awake until it ends. Then the part of the
+// period slept is known and added to millis().
+// Dig pin changes are latched by the pin change interrupt at any time,
+// UART input is reported by uartMenu() via powerSafeActivity() before
+// it is consumed.
+// PWM for brightness/contrast and UART receive keep working in idle
+// mode. Sleep period and LCD dimming are decided in power_safe.cpp.
+//
+extern volatile unsigned long timer0_millis;   // millis() counter, wiring.c
+
+static volatile bool wdtRunning;         // watchdog period not ended yet
+static volatile bool inputWakeup;        // woken up by dig pin change
+static unsigned long wdtPeriod;          // ms of current watchdog period
+static unsigned long wdtStartMillis;     // millis() at start of period
+static volatile bool lagPending;         // millis() caught up after input
+static unsigned long lagStart;           // period start, awake time
+static unsigned long lagAwake;           // and ms added to millis() for
+static unsigned long lagSlept;           // idleCorrect()
+
+ISR(WDT_vect)
+{
+  unsigned long awake;
+  unsigned long slept;
+
+  wdt_disable();
+  awake = timer0_millis - wdtStartMillis;
+  slept = idleSlept( wdtPeriod, awake );
+  timer0_millis += slept;
+  powerSafeSleepTime += slept;
+  wdtRunning = false;
+
+  if( awake > 0 )
+  {
+    // activity recorded while awake is behind by slept
+    lagStart = wdtStartMillis;
+    lagAwake = awake;
+    lagSlept = slept;
+    lagPending = true;
+  }
+}
+
+ISR(PCINT1_vect)
+{
+  inputWakeup = true;
+}
+
+// ---------------------------------------------------------
+// void idleSleep( unsigned long sleepTime )
+//
+// sleep for the longest watchdog period not exceeding
+// sleepTime or until an interrupt of dig or UART occurs.
+// millis() is advanced by the watchdog ISR at the end of
+// the period. Does not sleep while a period interrupted
+// by an input is still running.
+// ---------------------------------------------------------
+void idleSleep( unsigned long sleepTime )
+{
+  unsigned long period;
+  byte prescaler;
+
+  prescaler = idlePrescaler( sleepTime, &period );
+
+  if( prescaler == IDLE_NO_SLEEP || wdtRunning )
+  {
+    return;
+  }
+
+  // finish pending output - UART TX would wake us immediately
+  Serial.flush();
+
+  cli();
+  wdtPeriod = period;
+  wdtStartMillis = timer0_millis;
+  wdtRunning = true;
+  wdt_reset();
+  MCUSR &= ~_BV(WDRF);
+  WDTCSR = _BV(WDCE) | _BV(WDE);
+  WDTCSR = _BV(WDIE) | ((prescaler & 0x08) << 2) | (prescaler & 0x07);
+
+  TIMSK0 &= ~_BV(TOIE0);               // stop millis() tick
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_enable();
+  sei();
+  sleep_cpu();
+  sleep_disable();
+
+  cli();
+  TIMSK0 |= _BV(TOIE0);
+  sei();
+
+  powerSafeWakeups++;
+}
+
+// ---------------------------------------------------------
+// void powerSafeIdle( unsigned long nextRefresh )
+//
+// called from main loop when there is nothing to do.
+// pass input activity to idleSchedule(), dim or restore
+// LCD as requested and sleep until next display refresh
+// (nextRefresh ms) is due.
+// ---------------------------------------------------------
+void powerSafeIdle( unsigned long nextRefresh )
+{
+  static struct _idle_state_ idleState;
+  unsigned long sleepTime;
+  unsigned long start = 0;
+  unsigned long awake = 0;
+  unsigned long slept = 0;
+  bool corrected = false;
+  bool activity = false;
+  byte action;
+
+  cli();
+  if( lagPending )
+  {
+    start = lagStart;
+    awake = lagAwake;
+    slept = lagSlept;
+    lagPending = false;
+    corrected = true;
+  }
+  sei();
+
+  if( corrected )
+  {
+    idleCorrect( &idleState, start, awake, slept );
+  }
+
+  if( inputWakeup || inputActivity )
+  {
+    inputWakeup = false;
+    inputActivity = false;
+    activity = true;
+  }
+
+  if( Serial.available() || digitalRead(PIN_ENCODER_PUSH) == LOW ||
+      !currentPowerSafeMode )
+  {
+    activity = true;
+  }
+
+  if( menuStatus == DO_UART_CONTROL && !activity )
+  {
+    return;
+  }
+
+  sleepTime = idleSchedule( &idleState, millis(), nextRefresh, 
+                            activity, &action );
+
+  if( action == IDLE_ACTION_DIM )
+  {
+    dimLCD();
+  }
+
+  if( action == IDLE_ACTION_HIGHLIGHT )
+  {
+    if( currentPowerSafeMode )
+    {
+      highlightLCD();
+    }
+    else
+    {
+      analogWrite(PIN_BRIGHTNESS, 255-currentBrightness);
+    }
+  }
+
+  idleSleep( sleepTime );
+}
+
+//
+// ---------------------------------- END POWER SAFE -----------------------------------
+//
+#endif // USE_POWER_SAFE
+
 //
 // ------------------------------------- MAIN LOOP -------------------------------------
 //
@@ -3830,10 +5382,15 @@ void loop(void)
   if( digitalRead(PIN_PUSH_BUTTON) == LOW )
   {
     doTestRun();
+    powerSafeActivity();
   }
 #endif // USE_DIG_ENCODER
 
+#ifdef USE_POWER_SAFE
+  powerSafeIdle( idleDisplay(false) );
+#else
   idleDisplay(false);
+#endif // USE_POWER_SAFE
 }
 
 /* ------------------------- no needed stuff behind this line -------------------------- */
@@ -0,0 +1,184 @@
+//
+// ************************************************************************
+//
+// power_safe
+//    add on for: atmega ds18x20 tester (c) 2017 by fsa
+//
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//-------- brief description ---------------------------------------------
+//
+// decisions of the power safe idle loop that do not depend on the
+// hardware: watchdog period, LCD dimming, sleep deadline and time
+// slept. Compiles for the ATmega and for the host (__i386__).
+//
+//-------- History -------------------------------------------------------
+//
+// 1st version:
+//         watchdog period, idle schedule, time slept
+// update:
+//         correct last activity recorded before millis() catches up
+//
+//
+// ************************************************************************
+//
+
+//
+// -------------------------- INCLUDE SECTION ---------------------------
+//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "power_safe.h"
+
+
+// ---------------------------------------------------------
+// byte idlePrescaler( unsigned long sleepTime,
+//                     unsigned long *p_period )
+//
+// select the longest watchdog period (16 ms << prescaler)
+//      not exceeding sleepTime. The period in ms is stored
+//      in p_period. Return the prescaler (WDTO_15MS ...
+//      WDTO_8S) or IDLE_NO_SLEEP if sleepTime is shorter
+//      than the shortest period.
+// ---------------------------------------------------------
+byte idlePrescaler( unsigned long sleepTime, unsigned long *p_period )
+{
+  unsigned long period = IDLE_MIN_SLEEP;
+  byte prescaler = 0;
+
+  if( sleepTime < IDLE_MIN_SLEEP )
+  {
+    return( IDLE_NO_SLEEP );
+  }
+
+  while( prescaler < IDLE_MAX_PRESCALER && (period << 1) <= sleepTime )
+  {
+    prescaler++;
+    period <<= 1;
+  }
+
+  if( p_period != NULL )
+  {
+    *p_period = period;
+  }
+
+  return( prescaler );
+}
+
+// ---------------------------------------------------------
+// unsigned long idleSchedule( struct _idle_state_ *p_state,
+//                             unsigned long now,
+//                             unsigned long nextRefresh,
+//                             bool activity, byte *p_action )
+//
+// called from idle loop with millis() as now and ms until
+// the next display refresh. Input activity keeps the MCU
+// awake for IDLE_AWAKE_TIME and restores the LCD, after
+// IDLE_DIM_TIMEOUT w/o input the LCD is dimmed. While
+// dimmed the display refresh is not waited for.
+// p_action tells the caller what to do with the LCD.
+// Return ms to sleep, 0 to stay awake.
+// ---------------------------------------------------------
+unsigned long idleSchedule( struct _idle_state_ *p_state, unsigned long now,
+                            unsigned long nextRefresh, bool activity,
+                            byte *p_action )
+{
+  unsigned long idleTime;
+
+  *p_action = IDLE_ACTION_NONE;
+
+  if( activity )
+  {
+    p_state->lastActivity = now;
+    if( p_state->dimmed )
+    {
+      p_state->dimmed = false;
+      *p_action = IDLE_ACTION_HIGHLIGHT;
+    }
+    return( 0 );
+  }
+
+  idleTime = now - p_state->lastActivity;
+
+  if( idleTime < IDLE_AWAKE_TIME )
+  {
+    return( 0 );
+  }
+
+  if( !p_state->dimmed && idleTime >= IDLE_DIM_TIMEOUT )
+  {
+    p_state->dimmed = true;
+    *p_action = IDLE_ACTION_DIM;
+  }
+
+  if( p_state->dimmed )
+  {
+    return( IDLE_MAX_SLEEP );
+  }
+
+  // wake up in time to dim the LCD
+  if( nextRefresh > IDLE_DIM_TIMEOUT - idleTime )
+  {
+    nextRefresh = IDLE_DIM_TIMEOUT - idleTime;
+  }
+
+  return( nextRefresh );
+}
+
+// ---------------------------------------------------------
+// unsigned long idleSlept( unsigned long period,
+//                          unsigned long awakeTime )
+//
+// return the ms slept during a watchdog period that has
+//      just ended. awakeTime is the time counted by
+//      millis() since the period started, i.e. the time
+//      awake after an input woke the MCU before the end
+//      of the period.
+// ---------------------------------------------------------
+unsigned long idleSlept( unsigned long period, unsigned long awakeTime )
+{
+  if( awakeTime >= period )
+  {
+    return( 0 );
+  }
+
+  return( period - awakeTime );
+}
+
+// ---------------------------------------------------------
+// void idleCorrect( struct _idle_state_ *p_state,
+//                   unsigned long periodStart,
+//                   unsigned long awakeTime,
+//                   unsigned long slept )
+//
+// millis() has been advanced by slept at the end of a
+// watchdog period that started at periodStart and was
+// interrupted by input awakeTime ms before its end. The
+// last activity recorded while awake in that period is
+// behind by slept as well, move it forward.
+// ---------------------------------------------------------
+void idleCorrect( struct _idle_state_ *p_state, unsigned long periodStart,
+                  unsigned long awakeTime, unsigned long slept )
+{
+  if( p_state->lastActivity - periodStart <= awakeTime )
+  {
+    p_state->lastActivity += slept;
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef _POWER_SAFE_
+#define _POWER_SAFE_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#ifndef byte
+  typedef uint8_t byte;
+#endif // byte
+
+#ifndef __i386__
+  #if defined(ARDUINO) && ARDUINO >= 100
+    #include "Arduino.h"
+  #else
+    #include "WProgram.h"
+  #endif
+#else
+  #include <stdbool.h>
+#endif // __i386__
+
+
+//
+// ------------------------------ POWER SAFE IDLE HANDLING -----------------------------
+//
+// hardware independent part of power safe mode. The firmware
+// passes millis() and input activity, gets back how long to sleep
+// and how to handle the LCD. The same code is run by the host
+// simulation in power_safe_sim.cpp.
+//
+
+#define IDLE_AWAKE_TIME          2000      // stay awake 2 sec. after input
+#define IDLE_DIM_TIMEOUT        30000      // dim LCD after 30 sec. w/o input
+#define IDLE_MIN_SLEEP             16      // shortest watchdog period
+#define IDLE_MAX_PRESCALER          9      // WDTO_8S
+#define IDLE_MAX_SLEEP           8192      // longest watchdog period
+#define IDLE_NO_SLEEP            0xff      // prescaler: do not sleep
+
+#define IDLE_ACTION_NONE            0      // leave LCD as it is
+#define IDLE_ACTION_DIM             1      // dim LCD
+#define IDLE_ACTION_HIGHLIGHT       2      // restore LCD brightness
+
+struct _idle_state_ {
+unsigned long lastActivity;                // millis() of last input
+bool dimmed;                               // LCD is dimmed
+};
+
+byte idlePrescaler( unsigned long sleepTime, unsigned long *p_period );
+
+unsigned long idleSchedule( struct _idle_state_ *p_state, unsigned long now,
+                            unsigned long nextRefresh, bool activity,
+                            byte *p_action );
+
+unsigned long idleSlept( unsigned long period, unsigned long awakeTime );
+
+void idleCorrect( struct _idle_state_ *p_state, unsigned long periodStart,
+                  unsigned long awakeTime, unsigned long slept );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _POWER_SAFE_
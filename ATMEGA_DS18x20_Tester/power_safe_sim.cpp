@@ -0,0 +1,651 @@
+//
+// ************************************************************************
+//
+// power_safe_sim
+//    add on for: atmega ds18x20 tester (c) 2017 by fsa
+//
+// ************************************************************************
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ************************************************************************
+//
+//-------- brief description ---------------------------------------------
+//
+// host simulation of the power safe idle loop. Runs the code of
+// power_safe.cpp against a simulated clock and a model of the
+// firmware's loop(), watchdog and wake sources:
+//   dig   - pin change interrupt wakes the MCU and latches the
+//           input (SIM_PCINT_WHILE_AWAKE: also while awake)
+//   UART  - RX interrupt wakes the MCU, uartMenu() consumes the
+//           byte before powerSafeIdle() runs and reports it via
+//           powerSafeActivity() (SIM_UART_ACTIVITY_HOOK)
+//   menu  - dig click opens a menu, loop() is blocked while the
+//           dig is turned in the menu
+// Checks wake latency and LCD highlight latency of dig and UART
+// input, LCD dimming after menus, millis() after input wakeups
+// and counts wakeups per minute in idle. Building with one of the
+// model switches set to 0 shows the checks failing.
+//
+// build and run on the host:
+//   g++ -D__i386__ -DPOWER_SAFE_SIM -o power_safe_sim
+//       power_safe.cpp power_safe_sim.cpp
+//   ./power_safe_sim
+//
+// exit status is 0 if all checks passed.
+//
+//-------- History -------------------------------------------------------
+//
+// 1st version:
+//         idle, dig and UART wakeup scenarios
+// update:
+//         model wake sources as handled by the firmware, menu
+//         scenario, LCD highlight latency
+//
+//
+// ************************************************************************
+//
+
+#ifdef POWER_SAFE_SIM
+
+//
+// -------------------------- INCLUDE SECTION ---------------------------
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "power_safe.h"
+
+//
+// firmware behaviour modelled
+//
+#ifndef SIM_PCINT_WHILE_AWAKE
+#define SIM_PCINT_WHILE_AWAKE       1      // PCIE1 enabled in setup()
+#endif // SIM_PCINT_WHILE_AWAKE
+
+#ifndef SIM_UART_ACTIVITY_HOOK
+#define SIM_UART_ACTIVITY_HOOK      1      // uartMenu() reports input
+#endif // SIM_UART_ACTIVITY_HOOK
+
+//
+// same values as in the firmware
+//
+#define SIM_REFRESH_TOGGLE_LINE  1500      // LCD_REFRESH_TOGGLE_LINE
+#define SIM_REFRESH_SCROLL_LINE   700      // LCD_REFRESH_SCROLL_LINE
+#define SIM_LOOP_TIME               1      // ms for one pass of loop()
+#define SIM_MINUTE              60000UL
+#define SIM_MENU_TIME           40000UL    // time spent in a menu
+#define SIM_MENU_STEP            1000UL    // dig turned in menu
+
+#define SIM_INPUT_DIG               1      // dig turned
+#define SIM_INPUT_UART              2      // byte received
+#define SIM_INPUT_MENU              3      // dig click, menu session
+
+#define SIM_MAX_EVENTS            256
+
+struct _sim_event_ {
+unsigned long time;                        // true time of input
+byte source;
+};
+
+struct _sim_ {
+unsigned long trueTime;                    // real time in ms
+unsigned long millis;                      // firmware's millis()
+bool wdtRunning;                           // watchdog period running
+unsigned long wdtPeriod;
+unsigned long wdtStartMillis;
+unsigned long wdtEnd;                      // true time period ends
+unsigned long lastToggle;                  // idleDisplay() state
+unsigned long lastScroll;
+struct _idle_state_ idle;
+bool inputWakeup;                          // latched by PCINT1_vect
+bool inputActivity;                        // set by powerSafeActivity()
+bool rxPending;                            // byte in UART RX buffer
+bool lagPending;                           // millis() caught up after input
+unsigned long lagStart;
+unsigned long lagAwake;
+unsigned long lagSlept;
+struct _sim_event_ event[SIM_MAX_EVENTS];
+int numEvents;
+int nextEvent;
+// results
+bool unseen;                               // input not seen by idle loop
+unsigned long unseenSince;
+bool highlightPending;                     // input while LCD dimmed
+unsigned long highlightSince;
+unsigned long lastInput;                   // true time of last input
+unsigned long wakeups;
+unsigned long maxLatency;
+unsigned long maxHighlight;
+unsigned long earlyDims;                   // dimmed too early
+unsigned long dimTime;                     // true time LCD was dimmed
+bool dimmed;
+long maxMillisError;                       // millis() - true time
+};
+
+static int failures;
+
+// ---------------------------------------------------------
+// void simCheck( bool ok, const char *what )
+//
+// count and report failed checks
+// ---------------------------------------------------------
+void simCheck( bool ok, const char *what )
+{
+  printf("  %s: %s\n", ok ? "ok  " : "FAIL", what);
+  if( !ok )
+  {
+    failures++;
+  }
+}
+
+// ---------------------------------------------------------
+// void simInit( struct _sim_ *p_sim )
+//
+// start with the firmware just after power on
+// ---------------------------------------------------------
+void simInit( struct _sim_ *p_sim )
+{
+  struct _sim_ zero = {};
+
+  *p_sim = zero;
+}
+
+// ---------------------------------------------------------
+// void simAddInput( struct _sim_ *p_sim, unsigned long time,
+//                   byte source )
+//
+// add an input event, events have to be added in order
+// ---------------------------------------------------------
+void simAddInput( struct _sim_ *p_sim, unsigned long time, byte source )
+{
+  if( p_sim->numEvents < SIM_MAX_EVENTS )
+  {
+    p_sim->event[p_sim->numEvents].time = time;
+    p_sim->event[p_sim->numEvents].source = source;
+    p_sim->numEvents++;
+  }
+}
+
+// ---------------------------------------------------------
+// unsigned long simIdleDisplay( struct _sim_ *p_sim )
+//
+// model of idleDisplay() for a 16x2 LCD: refresh toggle
+// and scroll line, return ms until next refresh
+// ---------------------------------------------------------
+unsigned long simIdleDisplay( struct _sim_ *p_sim )
+{
+  unsigned long nextRefresh;
+  unsigned long elapsed;
+
+  if( p_sim->millis - p_sim->lastToggle >= SIM_REFRESH_TOGGLE_LINE )
+  {
+    p_sim->lastToggle = p_sim->millis;
+  }
+
+  if( p_sim->millis - p_sim->lastScroll >= SIM_REFRESH_SCROLL_LINE )
+  {
+    p_sim->lastScroll = p_sim->millis;
+  }
+
+  elapsed = p_sim->millis - p_sim->lastToggle;
+  nextRefresh = SIM_REFRESH_TOGGLE_LINE - elapsed;
+
+  elapsed = p_sim->millis - p_sim->lastScroll;
+  if( SIM_REFRESH_SCROLL_LINE - elapsed < nextRefresh )
+  {
+    nextRefresh = SIM_REFRESH_SCROLL_LINE - elapsed;
+  }
+
+  return( nextRefresh );
+}
+
+// ---------------------------------------------------------
+// void simWdtEnd( struct _sim_ *p_sim )
+//
+// model of ISR(WDT_vect): add the time slept to millis(),
+// remember correction if the period was interrupted
+// ---------------------------------------------------------
+void simWdtEnd( struct _sim_ *p_sim )
+{
+  unsigned long awake = p_sim->millis - p_sim->wdtStartMillis;
+  unsigned long slept = idleSlept( p_sim->wdtPeriod, awake );
+
+  p_sim->millis += slept;
+  p_sim->wdtRunning = false;
+
+  if( awake > 0 )
+  {
+    p_sim->lagStart = p_sim->wdtStartMillis;
+    p_sim->lagAwake = awake;
+    p_sim->lagSlept = slept;
+    p_sim->lagPending = true;
+  }
+}
+
+// ---------------------------------------------------------
+// void simTrackError( struct _sim_ *p_sim )
+//
+// remember the largest deviation of millis() from true time
+// ---------------------------------------------------------
+void simTrackError( struct _sim_ *p_sim )
+{
+  long error = labs( (long) (p_sim->millis - p_sim->trueTime) );
+
+  if( error > p_sim->maxMillisError )
+  {
+    p_sim->maxMillisError = error;
+  }
+}
+
+// ---------------------------------------------------------
+// void simAwake( struct _sim_ *p_sim, unsigned long duration )
+//
+// MCU awake for duration ms, millis() ticks. The watchdog
+// ISR runs when a period interrupted by input ends.
+// ---------------------------------------------------------
+void simAwake( struct _sim_ *p_sim, unsigned long duration )
+{
+  unsigned long step;
+
+  if( p_sim->wdtRunning && p_sim->trueTime + duration >= p_sim->wdtEnd )
+  {
+    step = p_sim->wdtEnd - p_sim->trueTime;
+    p_sim->trueTime += step;
+    p_sim->millis += step;
+    duration -= step;
+    simWdtEnd( p_sim );
+  }
+
+  p_sim->trueTime += duration;
+  p_sim->millis += duration;
+}
+
+// ---------------------------------------------------------
+// void simInput( struct _sim_ *p_sim, byte source,
+//                bool asleep, bool measure )
+//
+// input at current true time. Dig input is latched by the
+// pin change interrupt if it is enabled, a UART byte goes
+// to the RX buffer. measure is false for input handled by
+// a menu, it only counts as last input.
+// ---------------------------------------------------------
+void simInput( struct _sim_ *p_sim, byte source, bool asleep, bool measure )
+{
+  p_sim->lastInput = p_sim->trueTime;
+
+  if( measure && !p_sim->unseen )
+  {
+    p_sim->unseen = true;
+    p_sim->unseenSince = p_sim->trueTime;
+  }
+
+  if( measure && p_sim->dimmed && !p_sim->highlightPending )
+  {
+    p_sim->highlightPending = true;
+    p_sim->highlightSince = p_sim->trueTime;
+  }
+
+  if( source == SIM_INPUT_UART )
+  {
+    p_sim->rxPending = true;
+  }
+  else if( asleep || SIM_PCINT_WHILE_AWAKE )
+  {
+    p_sim->inputWakeup = true;
+  }
+}
+
+// ---------------------------------------------------------
+// void simEvent( struct _sim_ *p_sim, byte source,
+//                bool asleep )
+//
+// handle an input event. A menu session blocks loop() for
+// SIM_MENU_TIME, the dig is turned every SIM_MENU_STEP.
+// ---------------------------------------------------------
+void simEvent( struct _sim_ *p_sim, byte source, bool asleep )
+{
+  unsigned long time;
+
+  if( source != SIM_INPUT_MENU )
+  {
+    simInput( p_sim, source, asleep, true );
+    return;
+  }
+
+  simInput( p_sim, SIM_INPUT_DIG, asleep, false );
+
+  for( time = 0; time < SIM_MENU_TIME; time += SIM_MENU_STEP )
+  {
+    simAwake( p_sim, SIM_MENU_STEP );
+    simInput( p_sim, SIM_INPUT_DIG, false, false );
+  }
+}
+
+// ---------------------------------------------------------
+// void simSleep( struct _sim_ *p_sim, unsigned long sleepTime )
+//
+// model of idleSleep(): sleep for one watchdog period or
+// until the next input, millis() does not tick
+// ---------------------------------------------------------
+void simSleep( struct _sim_ *p_sim, unsigned long sleepTime )
+{
+  unsigned long period;
+
+  if( idlePrescaler( sleepTime, &period ) == IDLE_NO_SLEEP ||
+      p_sim->wdtRunning )
+  {
+    simAwake( p_sim, SIM_LOOP_TIME );
+    return;
+  }
+
+  p_sim->wdtPeriod = period;
+  p_sim->wdtStartMillis = p_sim->millis;
+  p_sim->wdtEnd = p_sim->trueTime + period;
+  p_sim->wdtRunning = true;
+  p_sim->wakeups++;
+
+  if( p_sim->nextEvent < p_sim->numEvents &&
+      p_sim->event[p_sim->nextEvent].time < p_sim->wdtEnd )
+  {
+    // dig and UART RX interrupts wake the MCU, period continues
+    p_sim->trueTime = p_sim->event[p_sim->nextEvent].time;
+    simEvent( p_sim, p_sim->event[p_sim->nextEvent].source, true );
+    p_sim->nextEvent++;
+  }
+  else
+  {
+    p_sim->trueTime = p_sim->wdtEnd;
+    simWdtEnd( p_sim );
+  }
+}
+
+// ---------------------------------------------------------
+// void simLatency( struct _sim_ *p_sim )
+//
+// input has been seen by the idle loop
+// ---------------------------------------------------------
+void simLatency( struct _sim_ *p_sim )
+{
+  if( p_sim->unseen )
+  {
+    if( p_sim->trueTime - p_sim->unseenSince > p_sim->maxLatency )
+    {
+      p_sim->maxLatency = p_sim->trueTime - p_sim->unseenSince;
+    }
+    p_sim->unseen = false;
+  }
+}
+
+// ---------------------------------------------------------
+// void simHighlight( struct _sim_ *p_sim )
+//
+// LCD brightness has been restored
+// ---------------------------------------------------------
+void simHighlight( struct _sim_ *p_sim )
+{
+  if( p_sim->highlightPending )
+  {
+    if( p_sim->trueTime - p_sim->highlightSince > p_sim->maxHighlight )
+    {
+      p_sim->maxHighlight = p_sim->trueTime - p_sim->highlightSince;
+    }
+    p_sim->highlightPending = false;
+  }
+}
+
+// ---------------------------------------------------------
+// void simRun( struct _sim_ *p_sim, unsigned long duration )
+//
+// run loop() for duration ms of true time
+// ---------------------------------------------------------
+void simRun( struct _sim_ *p_sim, unsigned long duration )
+{
+  unsigned long end = p_sim->trueTime + duration;
+  unsigned long nextRefresh;
+  unsigned long sleepTime;
+  bool activity;
+  byte action;
+
+  while( p_sim->trueTime < end )
+  {
+    // input while awake
+    while( p_sim->nextEvent < p_sim->numEvents &&
+           p_sim->event[p_sim->nextEvent].time <= p_sim->trueTime )
+    {
+      simEvent( p_sim, p_sim->event[p_sim->nextEvent].source, false );
+      p_sim->nextEvent++;
+    }
+
+    // uartMenu() consumes all input
+    if( p_sim->rxPending )
+    {
+      p_sim->rxPending = false;
+      if( SIM_UART_ACTIVITY_HOOK )
+      {
+        p_sim->inputActivity = true;
+      }
+    }
+
+    nextRefresh = simIdleDisplay( p_sim );
+
+    // powerSafeIdle()
+    if( p_sim->lagPending )
+    {
+      idleCorrect( &p_sim->idle, p_sim->lagStart, p_sim->lagAwake,
+                   p_sim->lagSlept );
+      p_sim->lagPending = false;
+    }
+
+    activity = p_sim->inputWakeup || p_sim->inputActivity;
+    p_sim->inputWakeup = false;
+    p_sim->inputActivity = false;
+
+    if( activity )
+    {
+      simLatency( p_sim );
+    }
+
+    sleepTime = idleSchedule( &p_sim->idle, p_sim->millis, nextRefresh,
+                              activity, &action );
+
+    if( action == IDLE_ACTION_DIM )
+    {
+      if( p_sim->trueTime - p_sim->lastInput < IDLE_DIM_TIMEOUT )
+      {
+        p_sim->earlyDims++;
+      }
+      p_sim->dimTime = p_sim->trueTime;
+      p_sim->dimmed = true;
+    }
+
+    if( action == IDLE_ACTION_HIGHLIGHT )
+    {
+      p_sim->dimmed = false;
+      simHighlight( p_sim );
+    }
+
+    simSleep( p_sim, sleepTime );
+    simTrackError( p_sim );
+  }
+
+  // input never seen counts up to now
+  if( p_sim->unseen && 
+      p_sim->trueTime - p_sim->unseenSince > p_sim->maxLatency )
+  {
+    p_sim->maxLatency = p_sim->trueTime - p_sim->unseenSince;
+  }
+
+  if( p_sim->highlightPending &&
+      p_sim->trueTime - p_sim->highlightSince > p_sim->maxHighlight )
+  {
+    p_sim->maxHighlight = p_sim->trueTime - p_sim->highlightSince;
+  }
+}
+
+// ---------------------------------------------------------
+// void simPrescalers( void )
+//
+// check watchdog period selection
+// ---------------------------------------------------------
+void simPrescalers( void )
+{
+  unsigned long period = 0;
+
+  printf("watchdog periods\n");
+  simCheck( idlePrescaler( IDLE_MIN_SLEEP - 1, &period ) == IDLE_NO_SLEEP,
+            "no sleep below shortest period" );
+  simCheck( idlePrescaler( IDLE_MIN_SLEEP, &period ) == 0 &&
+            period == IDLE_MIN_SLEEP, "16 ms period" );
+  simCheck( idlePrescaler( 1500, &period ) == 6 && period == 1024,
+            "1500 ms sleeps 1024 ms" );
+  simCheck( idlePrescaler( IDLE_MAX_SLEEP - 1, &period ) == 8 &&
+            period == 4096, "8191 ms sleeps 4096 ms" );
+  simCheck( idlePrescaler( IDLE_MAX_SLEEP, &period ) == IDLE_MAX_PRESCALER &&
+            period == IDLE_MAX_SLEEP, "8192 ms sleeps 8192 ms" );
+  simCheck( idlePrescaler( 100000UL, &period ) == IDLE_MAX_PRESCALER &&
+            period == IDLE_MAX_SLEEP, "longest period is 8192 ms" );
+}
+
+// ---------------------------------------------------------
+// void simIdle( void )
+//
+// no input at all: dim LCD after timeout and count wakeups
+// ---------------------------------------------------------
+void simIdle( void )
+{
+  static struct _sim_ sim;
+  unsigned long wakeups;
+
+  printf("idle w/o input\n");
+  simInit( &sim );
+
+  simRun( &sim, IDLE_DIM_TIMEOUT );
+  printf("  wakeups per minute, LCD on ....: %lu\n",
+         sim.wakeups * SIM_MINUTE / IDLE_DIM_TIMEOUT );
+
+  simRun( &sim, 10 * SIM_MINUTE );
+  simCheck( sim.dimmed, "LCD dimmed" );
+  simCheck( sim.dimTime >= IDLE_DIM_TIMEOUT &&
+            sim.dimTime <= IDLE_DIM_TIMEOUT + IDLE_MIN_SLEEP,
+            "LCD dimmed after IDLE_DIM_TIMEOUT" );
+
+  wakeups = sim.wakeups;
+  simRun( &sim, SIM_MINUTE );
+  wakeups = sim.wakeups - wakeups;
+  printf("  wakeups per minute, LCD dimmed : %lu\n", wakeups );
+  simCheck( wakeups <= SIM_MINUTE / IDLE_MAX_SLEEP + 1,
+            "one wakeup per 8192 ms while dimmed" );
+  simCheck( sim.maxMillisError == 0, "millis() follows true time" );
+}
+
+// ---------------------------------------------------------
+// void simCheckResults( struct _sim_ *p_sim )
+//
+// checks common to all input scenarios
+// ---------------------------------------------------------
+void simCheckResults( struct _sim_ *p_sim )
+{
+  char what[80];
+
+  snprintf( what, sizeof(what), "input seen by idle loop after %lu ms",
+            p_sim->maxLatency );
+  simCheck( p_sim->maxLatency <= SIM_LOOP_TIME, what );
+  snprintf( what, sizeof(what), "LCD highlighted after %lu ms",
+            p_sim->maxHighlight );
+  simCheck( p_sim->maxHighlight <= SIM_LOOP_TIME, what );
+  snprintf( what, sizeof(what), "LCD dimmed too early %lu times",
+            p_sim->earlyDims );
+  simCheck( p_sim->earlyDims == 0, what );
+  snprintf( what, sizeof(what), "millis() behind at most one period (%ld ms)",
+            p_sim->maxMillisError );
+  simCheck( p_sim->maxMillisError <= IDLE_MAX_SLEEP, what );
+  simCheck( p_sim->millis == p_sim->trueTime, "millis() does not drift" );
+  simCheck( p_sim->dimmed, "LCD dimmed again after last input" );
+}
+
+// ---------------------------------------------------------
+// void simInputs( byte source, const char *name )
+//
+// inputs at different points of a dimmed 8 sec. sleep and
+// while awake: check latencies and millis()
+// ---------------------------------------------------------
+void simInputs( byte source, const char *name )
+{
+  static struct _sim_ sim;
+  unsigned long time = IDLE_DIM_TIMEOUT + SIM_MINUTE;
+  int i;
+
+  printf("%s input\n", name);
+  simInit( &sim );
+
+  // inputs at pseudo random offsets, some during the awake time
+  srand( source );
+  for( i = 0; i < 100; i++ )
+  {
+    time += (i % 4 == 0) ? IDLE_AWAKE_TIME / 2 :
+            IDLE_DIM_TIMEOUT + (unsigned long) rand() % (2 * IDLE_MAX_SLEEP);
+    simAddInput( &sim, time, source );
+  }
+
+  simRun( &sim, time + IDLE_DIM_TIMEOUT + IDLE_MAX_SLEEP );
+  simCheckResults( &sim );
+}
+
+// ---------------------------------------------------------
+// void simMenus( void )
+//
+// dig turned to wake up, then clicked to open a menu for
+// longer than IDLE_DIM_TIMEOUT: LCD must not be dimmed right
+// after leaving the menu
+// ---------------------------------------------------------
+void simMenus( void )
+{
+  static struct _sim_ sim;
+  unsigned long time = IDLE_DIM_TIMEOUT + SIM_MINUTE;
+  int i;
+
+  printf("menu sessions\n");
+  simInit( &sim );
+
+  srand( SIM_INPUT_MENU );
+  for( i = 0; i < 10; i++ )
+  {
+    time += SIM_MENU_TIME + IDLE_DIM_TIMEOUT + 
+            (unsigned long) rand() % (2 * IDLE_MAX_SLEEP);
+    simAddInput( &sim, time, SIM_INPUT_DIG );
+    simAddInput( &sim, time + IDLE_AWAKE_TIME / 4, SIM_INPUT_MENU );
+  }
+
+  simRun( &sim, time + SIM_MENU_TIME + IDLE_DIM_TIMEOUT + IDLE_MAX_SLEEP );
+  simCheckResults( &sim );
+}
+
+int main( void )
+{
+  simPrescalers();
+  simIdle();
+  simInputs( SIM_INPUT_DIG, "dig" );
+  simInputs( SIM_INPUT_UART, "UART" );
+  simMenus();
+
+  printf("%s\n", failures == 0 ? "passed" : "FAILED");
+
+  return( failures == 0 ? 0 : 1 );
+}
+
+#endif // POWER_SAFE_SIM
@@ -37,6 +37,9 @@
 // 1st version: 05/22/17
 //         basic function
 // update:
+//         bus selector for control telegrams
+//         temperature and data telegrams
+//         alarm limits and alarm search telegrams
 //
 //
 // ************************************************************************
@@ -79,7 +82,7 @@ static byte softwareMajorRelease = 0;
 static byte softwareMinorRelease = 4;
 
 static byte protocolMajorRelease = 0;
-static byte protocolMinorRelease = 1;
+static byte protocolMinorRelease = 3;
 
 
 
@@ -140,6 +143,10 @@ OPCODE_CMD_READ_SCRATCHPAD,
 OPCODE_CMD_RUN_VERBOSE,
 OPCODE_CMD_RUN_SUMMARY,
 OPCODE_CMD_RUN_QUIET,
+OPCODE_CMD_SET_ALARM,
+OPCODE_CMD_ALARM_CONVERSION,
+OPCODE_CMD_1ST_ALARM_ID,
+OPCODE_CMD_NEXT_ALARM_ID,
 //
 END_OF_OPCODES_MARKER  // MUST STAY AT THIS POS!
 };
@@ -263,6 +270,56 @@ void dumpTelegram( struct _uart_telegram_ *p_telegram )
 
 #else
 
+// ----------------------------------------------------------------------
+// void dumpScratchpad( struct _uart_telegram_ *p_telegram )
+//
+// print temperature of a sensor response and the 1W bus time the
+// tester saved by reading only part of the scratchpad
+// ----------------------------------------------------------------------
+void dumpScratchpad( struct _uart_telegram_ *p_telegram )
+{
+  int numBytes;
+  int timeSaved = 0;
+  int16_t raw;
+
+  if( p_telegram->_arg_cnt < UART_RSP_DATA_POS + 2 )
+  {
+    return;
+  }
+
+  numBytes = p_telegram->_arg_cnt - UART_RSP_DATA_POS;
+
+  printf(" --- Bus: %d\n", p_telegram->_args[UART_RSP_BUS_POS]);
+
+  raw = (p_telegram->_args[UART_RSP_DATA_POS+1] << 8) | 
+         p_telegram->_args[UART_RSP_DATA_POS];
+  if( p_telegram->_args[1] == 0x10 )   // DS18S20
+  {
+    printf(" --- Temperature: %.2f C\n", (float) raw / 2.0 );
+  }
+  else
+  {
+    printf(" --- Temperature: %.4f C\n", (float) raw / 16.0 );
+  }
+
+  if( numBytes >= UART_1W_SCRATCHPAD_SIZE )
+  {
+    printf(" --- Scratchpad CRC: %s\n", 
+           CRC8(&p_telegram->_args[UART_RSP_DATA_POS], 8) == 
+           p_telegram->_args[UART_RSP_DATA_POS+8] ? "ok" : "FAIL" );
+  }
+
+  if( numBytes < UART_1W_SCRATCHPAD_SIZE )
+  {
+    // partial read is terminated by a bus reset
+    timeSaved = (UART_1W_SCRATCHPAD_SIZE - numBytes) * UART_1W_BYTE_TIME_US -
+                UART_1W_RESET_TIME_US;
+  }
+
+  printf(" --- Scratchpad bytes read: %d of %d, bus time saved: %d usec\n",
+         numBytes, UART_1W_SCRATCHPAD_SIZE, timeSaved );
+}
+
 void dumpTelegram( struct _uart_telegram_ *p_telegram )
 {
 
@@ -289,6 +346,8 @@ void dumpTelegram( struct _uart_telegram_ *p_telegram )
       {
         case OPCODE_CMD_1ST_SENSOR_ID:
         case OPCODE_CMD_NEXT_SENSOR_ID:
+        case OPCODE_CMD_1ST_ALARM_ID:
+        case OPCODE_CMD_NEXT_ALARM_ID:
           printf(" --- Sensor-ID: ");
           printf( "%02x-", p_telegram->_args[1] );
           for ( int i = 7; i > 1; i--)
@@ -297,6 +356,14 @@ void dumpTelegram( struct _uart_telegram_ *p_telegram )
           }
           printf("\n");
           break;
+        case OPCODE_CMD_1ST_SENSOR_TEMPERATURE:
+        case OPCODE_CMD_NEXT_SENSOR_TEMPERATURE:
+        case OPCODE_CMD_SENSOR_TEMPERATURE:
+        case OPCODE_CMD_1ST_SENSOR_DATA:
+        case OPCODE_CMD_NEXT_SENSOR_DATA:
+        case OPCODE_CMD_SENSOR_DATA:
+          dumpScratchpad( p_telegram );
+          break;
         default:
           break;
       }
@@ -342,11 +409,56 @@ bool uartSendResponse( struct _uart_telegram_ *p_command,
 
 #ifndef __i386__
 
-extern byte getFirstSensorID( byte addr[]  );
-extern byte getNextSensorID( byte addr[]  );
-extern byte getFirstSensorTemp( byte sensorID[] );
-extern byte getNextSensorTemp( byte sensorID[] );
-extern byte getSensorTemp( byte addr[] );
+extern byte getFirstSensorID( byte busIndex, byte addr[]  );
+extern byte getNextSensorID( byte busIndex, byte addr[]  );
+extern byte getFirstSensorTemp( byte busIndex, byte sensorID[], byte data[] );
+extern byte getNextSensorTemp( byte busIndex, byte sensorID[], byte data[] );
+extern byte getSensorTemp( byte busIndex, byte addr[], byte data[] );
+extern byte getFirstSensorData( byte busIndex, byte sensorID[], byte data[] );
+extern byte getNextSensorData( byte busIndex, byte sensorID[], byte data[] );
+extern byte getSensorData( byte busIndex, byte addr[], byte data[] );
+extern byte setSensorPower( byte busIndex, bool powerOn );
+extern byte setSensorAlarm( byte busIndex, byte sensorID[], int th, int tl );
+extern byte startAlarmConversion( byte busIndex );
+extern byte getFirstAlarmID( byte busIndex, byte sensorID[] );
+extern byte getNextAlarmID( byte busIndex, byte sensorID[] );
+
+
+// ----------------------------------------------------------------------
+// byte uartGetBusIndex( struct _uart_telegram_ *p_command )
+//
+// get 1W bus selector from first argument of a control telegram
+// ----------------------------------------------------------------------
+byte uartGetBusIndex( struct _uart_telegram_ *p_command )
+{
+  byte busIndex = UART_CTL_1WBUS_DEFAULT;
+
+  if( p_command->_arg_cnt > 0 )
+  {
+    busIndex = p_command->_args[0];
+  }
+
+  return( busIndex );
+}
+
+
+// ----------------------------------------------------------------------
+// bool uartGetSensorID( struct _uart_telegram_ *p_command, byte sensorID[] )
+//
+// copy sensor id from a "sensor with id" telegram
+// ----------------------------------------------------------------------
+bool uartGetSensorID( struct _uart_telegram_ *p_command, byte sensorID[] )
+{
+  bool retVal = false;
+
+  if( p_command->_arg_cnt >= UART_ARG_SENSOR_ID_POS + 8 )
+  {
+    memcpy( sensorID, &p_command->_args[UART_ARG_SENSOR_ID_POS], 8 );
+    retVal = true;
+  }
+
+  return( retVal );
+}
 
 
 void uartMakeDummyResponse( struct _uart_telegram_ *p_command,
@@ -358,7 +470,7 @@ void uartMakeDummyResponse( struct _uart_telegram_ *p_command,
 }
 
 
-void uartMakeAddrResponse( byte opSuccess, byte sensorID[],
+void uartMakeAddrResponse( byte opSuccess, byte busIndex, byte sensorID[],
                            struct _uart_telegram_ *p_command,
                            struct _uart_telegram_ *p_response )
 {
@@ -373,6 +485,30 @@ void uartMakeAddrResponse( byte opSuccess, byte sensorID[],
     p_response->_arg_cnt++;
   }
 
+  p_response->_args[p_response->_arg_cnt++] = busIndex;
+}
+
+
+void uartAppendData( byte data[], byte len,
+                     struct _uart_telegram_ *p_response )
+{
+  for( int i = 0; i < len && 
+                  p_response->_arg_cnt < REMOTE_COMMAND_MAX_ARGS; i++ )
+  {
+    p_response->_args[p_response->_arg_cnt++] = data[i];
+  }
+}
+
+
+void uartMakeBusResponse( byte opSuccess, byte busIndex,
+                          struct _uart_telegram_ *p_command,
+                          struct _uart_telegram_ *p_response )
+{
+  p_response->_opcode =   OPCODE_RESPONSE;
+  p_response->_status = opSuccess;
+  p_response->_args[0] = p_command->_opcode;
+  p_response->_args[1] = busIndex;
+  p_response->_arg_cnt = 2;
 }
 
 
@@ -389,6 +525,7 @@ bool uartControlRunCommand( struct _uart_telegram_ *p_command,
   byte resolution;
   long conversionTime;
   byte opSuccess;
+  byte busIndex;
 
   bool retVal = false;
 
@@ -413,47 +550,159 @@ bool uartControlRunCommand( struct _uart_telegram_ *p_command,
       // control telegrams from 0x30
       //
       case OPCODE_CMD_1ST_SENSOR_ID:               // get 1st sensor id
-        opSuccess = getFirstSensorID(W1Address);
-        uartMakeAddrResponse( opSuccess, W1Address, p_command, p_response );
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = getFirstSensorID( busIndex, W1Address );
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
         uartCompleteTelegram( p_response );
         uartSendTelegram( p_response );
         break;
       case OPCODE_CMD_NEXT_SENSOR_ID:              // get next sensor id
-        opSuccess = getNextSensorID(W1Address);
-        uartMakeAddrResponse( opSuccess, W1Address, p_command, p_response );
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = getNextSensorID( busIndex, W1Address );
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
         uartCompleteTelegram( p_response );
         uartSendTelegram( p_response );
         break;
       case OPCODE_CMD_1ST_SENSOR_TEMPERATURE:      // get temp for 1st sensor
-        opSuccess = getFirstSensorTemp( W1Address );
-        uartMakeAddrResponse( opSuccess, W1Address, p_command, p_response );
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = getFirstSensorTemp( busIndex, W1Address, data );
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
+        if( opSuccess )
+        {
+          uartAppendData( data, 2, p_response );
+        }
         uartCompleteTelegram( p_response );
         uartSendTelegram( p_response );
         break;
       case OPCODE_CMD_NEXT_SENSOR_TEMPERATURE:     // get temp for next sensor
-        opSuccess = getNextSensorTemp( W1Address );
-        uartMakeAddrResponse( opSuccess, W1Address, p_command, p_response );
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = getNextSensorTemp( busIndex, W1Address, data );
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
+        if( opSuccess )
+        {
+          uartAppendData( data, 2, p_response );
+        }
         uartCompleteTelegram( p_response );
         uartSendTelegram( p_response );
         break;
       case OPCODE_CMD_SENSOR_TEMPERATURE:          // get temp for sensor with id
-        opSuccess = getSensorTemp( W1Address );
-        uartMakeAddrResponse( opSuccess, W1Address, p_command, p_response );
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = 0;
+        if( uartGetSensorID( p_command, W1Address ) )
+        {
+          opSuccess = getSensorTemp( busIndex, W1Address, data );
+        }
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
+        if( opSuccess )
+        {
+          uartAppendData( data, 2, p_response );
+        }
         uartCompleteTelegram( p_response );
         uartSendTelegram( p_response );
         break;
-
       case OPCODE_CMD_1ST_SENSOR_DATA:             // get data block for 1st sensor
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = getFirstSensorData( busIndex, W1Address, data );
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
+        if( opSuccess )
+        {
+          uartAppendData( data, UART_1W_SCRATCHPAD_SIZE, p_response );
+        }
+        uartCompleteTelegram( p_response );
+        uartSendTelegram( p_response );
+        break;
       case OPCODE_CMD_NEXT_SENSOR_DATA:            // get data block for next sensor
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = getNextSensorData( busIndex, W1Address, data );
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
+        if( opSuccess )
+        {
+          uartAppendData( data, UART_1W_SCRATCHPAD_SIZE, p_response );
+        }
+        uartCompleteTelegram( p_response );
+        uartSendTelegram( p_response );
+        break;
       case OPCODE_CMD_SENSOR_DATA:                 // get data block for sensor with id
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = 0;
+        if( uartGetSensorID( p_command, W1Address ) )
+        {
+          opSuccess = getSensorData( busIndex, W1Address, data );
+        }
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
+        if( opSuccess )
+        {
+          uartAppendData( data, UART_1W_SCRATCHPAD_SIZE, p_response );
+        }
+        uartCompleteTelegram( p_response );
+        uartSendTelegram( p_response );
+        break;
+      case OPCODE_CMD_SET_ALARM:                   // set TH/TL for sensor with id or all
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = 0;
+        if( p_command->_arg_cnt > UART_ARG_ALARM_TL_POS )
+        {
+          if( p_command->_arg_cnt >= UART_ARG_ALARM_ID_POS + 8 )
+          {
+            memcpy( W1Address, &p_command->_args[UART_ARG_ALARM_ID_POS], 8 );
+            opSuccess = setSensorAlarm( busIndex, W1Address,
+                          (int8_t) p_command->_args[UART_ARG_ALARM_TH_POS],
+                          (int8_t) p_command->_args[UART_ARG_ALARM_TL_POS] );
+          }
+          else
+          {
+            opSuccess = setSensorAlarm( busIndex, NULL,
+                          (int8_t) p_command->_args[UART_ARG_ALARM_TH_POS],
+                          (int8_t) p_command->_args[UART_ARG_ALARM_TL_POS] );
+          }
+        }
+        uartMakeBusResponse( opSuccess > 0, busIndex, p_command, p_response );
+        p_response->_args[p_response->_arg_cnt++] = opSuccess;
+        uartCompleteTelegram( p_response );
+        uartSendTelegram( p_response );
+        break;
+      case OPCODE_CMD_ALARM_CONVERSION:            // start conversion on all sensors
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = startAlarmConversion( busIndex );
+        uartMakeBusResponse( opSuccess, busIndex, p_command, p_response );
+        uartCompleteTelegram( p_response );
+        uartSendTelegram( p_response );
+        break;
+      case OPCODE_CMD_1ST_ALARM_ID:                // get 1st sensor id with alarm set
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = getFirstAlarmID( busIndex, W1Address );
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
+        uartCompleteTelegram( p_response );
+        uartSendTelegram( p_response );
+        break;
+      case OPCODE_CMD_NEXT_ALARM_ID:               // get next sensor id with alarm set
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = getNextAlarmID( busIndex, W1Address );
+        uartMakeAddrResponse( opSuccess, busIndex, W1Address, p_command, p_response );
+        uartCompleteTelegram( p_response );
+        uartSendTelegram( p_response );
+        break;
+      case OPCODE_CMD_1WBUS_POWER_ON:              // power on 1w bus
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = setSensorPower( busIndex, true );
+        uartMakeBusResponse( opSuccess, busIndex, p_command, p_response );
+        uartCompleteTelegram( p_response );
+        uartSendTelegram( p_response );
+        break;
+      case OPCODE_CMD_1WBUS_POWER_OFF:             // power off 1w bus
+        busIndex = uartGetBusIndex( p_command );
+        opSuccess = setSensorPower( busIndex, false );
+        uartMakeBusResponse( opSuccess, busIndex, p_command, p_response );
+        uartCompleteTelegram( p_response );
+        uartSendTelegram( p_response );
+        break;
+
       case OPCODE_CMD_1ST_SENSOR_GET_RESOLUTION:   // get resolution for 1st sensor
       case OPCODE_CMD_NEXT_SENSOR_GET_RESOLUTION:  // get resolution for next sensor
       case OPCODE_CMD_SENSOR_GET_RESOLUTION:       // get resolution for sensor with id
       case OPCODE_CMD_1ST_SENSOR_SET_RESOLUTION:   // set resolution for 1st sensor
       case OPCODE_CMD_NEXT_SENSOR_SET_RESOLUTION:  // set resolution for next sensor
       case OPCODE_CMD_SENSOR_SET_RESOLUTION:       // set resolution for sensor with id
-      case OPCODE_CMD_1WBUS_POWER_ON:              // power on 1w bus
-      case OPCODE_CMD_1WBUS_POWER_OFF:             // power off 1w bus
       case OPCODE_CMD_1WBUS_RESET:                 // reset 1w bus
       case OPCODE_CMD_1WBUS_RESET_SEARCH:          // reset_search 1w bus
       case OPCODE_CMD_1WBUS_SELECT_ID:             // select id on 1W bus
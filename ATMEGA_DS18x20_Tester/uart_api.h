@@ -72,6 +72,32 @@ uint8_t _args[REMOTE_COMMAND_MAX_ARGS];
 #define OPCODE_RESEND                         0x06   // resend telegram 
 //
 // control telegrams from 0x30
+// first argument selects the 1W bus, telegrams without
+// arguments address the first bus
+//
+#define UART_CTL_1WBUS_DEFAULT      0      // bus if no selector is given
+                                           // 0xff: all busses (power on/off)
+//
+// "sensor with id" telegrams carry the id in _args[1..8]
+// sensor responses: _args[0] opcode, _args[1..8] sensor id,
+// _args[9] bus, followed by the scratchpad bytes read
+// (only if the read succeeded)
+// (temperature: bytes 0-1, data: bytes 0-8)
+//
+#define UART_ARG_SENSOR_ID_POS      1
+#define UART_RSP_BUS_POS            9
+#define UART_RSP_DATA_POS          10
+#define UART_1W_SCRATCHPAD_SIZE     9
+#define UART_1W_BYTE_TIME_US      560      // 1W bus time per byte
+#define UART_1W_RESET_TIME_US     960      // reset ending a partial read
+//
+// set alarm: _args[1] TH, _args[2] TL, optional sensor id in
+// _args[3..10], without id all sensors on the bus are set
+// response: _args[1] bus, _args[2] number of sensors set
+//
+#define UART_ARG_ALARM_TH_POS       1
+#define UART_ARG_ALARM_TL_POS       2
+#define UART_ARG_ALARM_ID_POS       3
 //
 #define OPCODE_CMD_1ST_SENSOR_ID              0x30   // get 1st sensor id
 #define OPCODE_CMD_NEXT_SENSOR_ID             0x31   // get next sensor id
@@ -99,6 +125,10 @@ uint8_t _args[REMOTE_COMMAND_MAX_ARGS];
 #define OPCODE_CMD_RUN_VERBOSE                0x46   // run testsequence send results
 #define OPCODE_CMD_RUN_SUMMARY                0x47   // run testsequence send summary
 #define OPCODE_CMD_RUN_QUIET                  0x48   // run testsequence discard output
+#define OPCODE_CMD_SET_ALARM                  0x49   // set TH/TL for sensor with id or all
+#define OPCODE_CMD_ALARM_CONVERSION           0x4a   // start conversion on all sensors
+#define OPCODE_CMD_1ST_ALARM_ID               0x4b   // get 1st sensor id with alarm set
+#define OPCODE_CMD_NEXT_ALARM_ID              0x4c   // get next sensor id with alarm set
 //
 #define END_OF_OPCODES_MARKER                 0xff    // end of opcodes indicator
 